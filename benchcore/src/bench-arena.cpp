@@ -0,0 +1,203 @@
+#include "bench-arena.h"
+#include "bench-recorder.h"
+#include "bench-topology.h"
+
+#include <sys/mman.h>
+#include <errno.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+#define SMALL_PAGE 4096
+#define HUGE_PAGE (2 << 20)
+
+static const gchar* page_names[BENCH_N_PAGES] = { "4k", "thp", "2m", "1g" };
+static const gsize page_sizes[BENCH_N_PAGES] = { SMALL_PAGE, HUGE_PAGE, HUGE_PAGE, 1 << 30 };
+
+const gchar*
+bench_pages_to_string(BenchPages pages)
+{
+    g_return_val_if_fail(pages < BENCH_N_PAGES, NULL);
+
+    return page_names[pages];
+}
+
+gboolean
+bench_pages_from_string(const gchar* str, BenchPages* pages)
+{
+    for (guint i = 0; i < BENCH_N_PAGES; i++)
+    {
+        if (g_ascii_strcasecmp(str, page_names[i]) == 0)
+        {
+            *pages = (BenchPages)i;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+gsize
+bench_pages_get_size(BenchPages pages)
+{
+    g_return_val_if_fail(pages < BENCH_N_PAGES, 0);
+
+    return page_sizes[pages];
+}
+
+static gsize
+round_up(gsize size, gsize page)
+{
+    return (size + page - 1) / page * page;
+}
+
+/* Reserved hugepages, fails right away if the pool is short */
+static gboolean
+map_hugetlb(BenchArena* arena, BenchPages pages, gboolean populate)
+{
+    gsize size = round_up(arena->size, page_sizes[pages]);
+    gint flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (pages == BENCH_PAGES_1G ? MAP_HUGE_1GB : MAP_HUGE_2MB);
+    void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, flags | (populate ? MAP_POPULATE : 0), -1, 0);
+
+    if (mapping == MAP_FAILED)
+        return FALSE;
+
+    arena->mapping = (guint8*)mapping;
+    arena->mapped = size;
+    arena->data = arena->mapping;
+    arena->pages = pages;
+
+    return TRUE;
+}
+
+/* THP only backs 2M aligned ranges, so the mapping is over-allocated by a
+ * hugepage and data starts at the first boundary in it */
+static gboolean
+map_thp(BenchArena* arena, gboolean populate)
+{
+    gsize size = round_up(arena->size, HUGE_PAGE);
+    void* mapping = mmap(NULL, size + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (mapping == MAP_FAILED)
+        return FALSE;
+
+    arena->mapping = (guint8*)mapping;
+    arena->mapped = size + HUGE_PAGE;
+    arena->data = (guint8*)round_up((gsize)mapping, HUGE_PAGE);
+    arena->pages = BENCH_PAGES_THP;
+
+    if (madvise(arena->data, size, MADV_HUGEPAGE) != 0)
+        g_warning("madvise(MADV_HUGEPAGE) failed: %s", g_strerror(errno));
+
+    /* MAP_POPULATE would fault in before the advice. Touching every 4K also
+     * faults in whatever the kernel could not back with a hugepage */
+    if (populate)
+    {
+        for (gsize offset = 0; offset < size; offset += SMALL_PAGE)
+            ((volatile guint8*)arena->data)[offset] = 0;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+map_small(BenchArena* arena, gboolean populate)
+{
+    gsize size = round_up(arena->size, SMALL_PAGE);
+    void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | (populate ? MAP_POPULATE : 0), -1, 0);
+
+    if (mapping == MAP_FAILED)
+        return FALSE;
+
+    arena->mapping = (guint8*)mapping;
+    arena->mapped = size;
+    arena->data = arena->mapping;
+    arena->pages = BENCH_PAGES_4K;
+
+    /* an older kernel without the advice still maps 4K unless THP is "always" */
+    madvise(arena->data, size, MADV_NOHUGEPAGE);
+
+    return TRUE;
+}
+
+/* One write per page, for mappings that are bound after mmap() */
+static void
+touch(BenchArena* arena)
+{
+    gsize step = arena->pages == BENCH_PAGES_THP ? SMALL_PAGE : page_sizes[arena->pages];
+
+    for (gsize offset = 0; offset < arena->size; offset += step)
+        ((volatile guint8*)arena->data)[offset] = 0;
+}
+
+BenchArena*
+bench_arena_new(gsize size, BenchPages pages, gboolean populate, gint node, GError** error)
+{
+    BenchArena* arena = g_new0(BenchArena, 1);
+    gint64 start = bench_now_ns();
+    gboolean mapped;
+
+    arena->size = size;
+    arena->requested = pages;
+    arena->populated = populate;
+    arena->node = node;
+
+    /* MAP_POPULATE would fault in before the binding */
+    gboolean map_populate = populate && node < 0;
+
+    switch (pages)
+    {
+    case BENCH_PAGES_2M:
+    case BENCH_PAGES_1G:
+        mapped = map_hugetlb(arena, pages, map_populate);
+        if (!mapped)
+        {
+            g_warning("no %s hugepages for %" G_GSIZE_FORMAT " bytes (%s), falling back to THP, see /proc/sys/vm/nr_hugepages",
+                page_names[pages], size, g_strerror(errno));
+            mapped = map_thp(arena, map_populate);
+        }
+        break;
+    case BENCH_PAGES_THP:
+        mapped = map_thp(arena, map_populate);
+        break;
+    default:
+        mapped = map_small(arena, map_populate);
+        break;
+    }
+
+    if (!mapped)
+    {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "could not map %" G_GSIZE_FORMAT " bytes: %s",
+            size, g_strerror(errno));
+        g_free(arena);
+        return NULL;
+    }
+
+    if (node >= 0)
+    {
+        /* the whole mapping, mbind() wants hugetlb ranges aligned to the
+         * hugepage and data is only 4K aligned within THP mappings */
+        if (!bench_bind_memory(arena->mapping, arena->mapped, node))
+            g_warning("could not bind the arena to node %d: %s", node, g_strerror(errno));
+        if (populate)
+            touch(arena);
+    }
+
+    arena->setup_ns = bench_now_ns() - start;
+
+    return arena;
+}
+
+void
+bench_arena_free(BenchArena* arena)
+{
+    munmap(arena->mapping, arena->mapped);
+    g_free(arena);
+}
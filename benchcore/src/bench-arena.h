@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glib.h>
+
+typedef enum
+{
+    BENCH_PAGES_4K,
+    BENCH_PAGES_THP,
+    BENCH_PAGES_2M,
+    BENCH_PAGES_1G,
+    BENCH_N_PAGES,
+} BenchPages;
+
+typedef struct _BenchArena BenchArena;
+
+/* One anonymous mapping for frames, backed by the requested page size. 2M
+ * and 1G use MAP_HUGETLB, which needs reserved hugepages, and fall back to
+ * transparent hugepages if there are none. 4K opts out of THP, so it really
+ * is 4K pages */
+struct _BenchArena
+{
+    guint8* data;
+    gsize size;
+
+    /* what was asked for and what the kernel gave */
+    BenchPages requested;
+    BenchPages pages;
+    gboolean populated;
+    /* -1 unless bound to a NUMA node */
+    gint node;
+
+    /* time spent in mapping and prefaulting */
+    gint64 setup_ns;
+
+    gsize mapped;
+    guint8* mapping;
+};
+
+const gchar* bench_pages_to_string(BenchPages pages);
+gboolean bench_pages_from_string(const gchar* str, BenchPages* pages);
+gsize bench_pages_get_size(BenchPages pages);
+
+/* With populate every page is faulted in here instead of on first touch. The
+ * memory is zeroed either way. A node other than -1 binds the pages to it
+ * before they are touched */
+BenchArena* bench_arena_new(gsize size, BenchPages pages, gboolean populate, gint node, GError** error);
+void bench_arena_free(BenchArena* arena);
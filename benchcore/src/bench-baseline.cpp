@@ -0,0 +1,85 @@
+#include "bench-baseline.h"
+
+BenchBaseline*
+bench_baseline_new()
+{
+    BenchBaseline* baseline = g_new0(BenchBaseline, 1);
+
+    baseline->key_file = g_key_file_new();
+
+    return baseline;
+}
+
+BenchBaseline*
+bench_baseline_load(const gchar* path, GError** error)
+{
+    BenchBaseline* baseline = bench_baseline_new();
+
+    if (!g_key_file_load_from_file(baseline->key_file, path, G_KEY_FILE_NONE, error))
+    {
+        bench_baseline_free(baseline);
+        return NULL;
+    }
+
+    return baseline;
+}
+
+void
+bench_baseline_free(BenchBaseline* baseline)
+{
+    g_key_file_free(baseline->key_file);
+    g_free(baseline);
+}
+
+gboolean
+bench_baseline_save(const BenchBaseline* baseline, const gchar* path, GError** error)
+{
+    return g_key_file_save_to_file(baseline->key_file, path, error);
+}
+
+void
+bench_baseline_set(BenchBaseline* baseline, const BenchGeometry* geometry, const gchar* kernel, gdouble ns)
+{
+    gchar* group = bench_geometry_to_string(geometry);
+
+    g_key_file_set_string(baseline->key_file, group, "kernel", kernel);
+    g_key_file_set_double(baseline->key_file, group, "run", ns);
+    g_free(group);
+}
+
+gboolean
+bench_baseline_lookup(const BenchBaseline* baseline, const BenchGeometry* geometry, gdouble* ns)
+{
+    gchar* group = bench_geometry_to_string(geometry);
+    GError* error = NULL;
+
+    *ns = g_key_file_get_double(baseline->key_file, group, "run", &error);
+    g_free(group);
+
+    if (error != NULL)
+    {
+        g_error_free(error);
+        return FALSE;
+    }
+
+    return *ns > 0;
+}
+
+void
+bench_baseline_compare(const BenchBaseline* baseline, BenchReport* report,
+    const BenchRecorder* recorder, const BenchGeometry* geometry)
+{
+    BenchStats stats;
+    gdouble ns;
+
+    if (baseline == NULL || !bench_baseline_lookup(baseline, geometry, &ns))
+        return;
+
+    bench_recorder_compute_stats(recorder, &stats);
+    if (stats.p50 <= 0)
+        return;
+
+    gchar* name = g_strdup_printf("%s of Native", recorder->name);
+    bench_report_set_value(report, name, 100 * ns / stats.p50, "%");
+    g_free(name);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <glib.h>
+
+#include "bench-geometry.h"
+#include "bench-recorder.h"
+#include "bench-report.h"
+
+typedef struct _BenchBaseline BenchBaseline;
+
+/* Best native batch time per geometry, written by native-test and read by the
+ * other harnesses with --baseline. Stored as a key file with one group per
+ * geometry. */
+struct _BenchBaseline
+{
+    GKeyFile* key_file;
+};
+
+BenchBaseline* bench_baseline_new();
+BenchBaseline* bench_baseline_load(const gchar* path, GError** error);
+void bench_baseline_free(BenchBaseline* baseline);
+gboolean bench_baseline_save(const BenchBaseline* baseline, const gchar* path, GError** error);
+
+void bench_baseline_set(BenchBaseline* baseline, const BenchGeometry* geometry, const gchar* kernel, gdouble ns);
+gboolean bench_baseline_lookup(const BenchBaseline* baseline, const BenchGeometry* geometry, gdouble* ns);
+
+/* Sets "<metric> of Native" to the baseline time as percentage of the median
+ * of recorder, does nothing without a baseline for the geometry */
+void bench_baseline_compare(const BenchBaseline* baseline, BenchReport* report,
+    const BenchRecorder* recorder, const BenchGeometry* geometry);
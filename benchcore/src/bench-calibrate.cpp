@@ -0,0 +1,421 @@
+#include "bench-calibrate.h"
+#include "bench-recorder.h"
+#include "bench-topology.h"
+
+#include <atomic>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#define CALIBRATE_X86
+#include <immintrin.h>
+#endif
+
+#define TRIALS 5
+
+typedef enum
+{
+    OP_INIT,
+    OP_COPY,
+    OP_TRIAD,
+} StreamOp;
+
+typedef struct _StreamThread StreamThread;
+typedef struct _StreamRun StreamRun;
+
+/* One trial of an operation on n_threads threads, each on its own chunk and
+ * pinned to the CPU of its index, so the chunk it first touched is local */
+struct _StreamRun
+{
+    StreamOp op;
+    const BenchTopology* topology;
+    gdouble* a;
+    gdouble* b;
+    gdouble* c;
+    gsize n;
+    guint n_threads;
+
+    std::atomic<guint> ready;
+    std::atomic<gboolean> go;
+};
+
+struct _StreamThread
+{
+    StreamRun* run;
+    guint index;
+    gint64 start;
+    gint64 end;
+};
+
+/* c = a, bypassing the caches so there is no read for ownership */
+static void
+stream_copy(gdouble* c, const gdouble* a, gsize n)
+{
+    gsize i = 0;
+
+#ifdef __SSE2__
+    for (; i + 2 <= n; i += 2)
+        _mm_stream_pd(c + i, _mm_load_pd(a + i));
+    _mm_sfence();
+#endif
+    for (; i < n; i++)
+        c[i] = a[i];
+}
+
+/* a = b + s * c */
+static void
+stream_triad(gdouble* a, const gdouble* b, const gdouble* c, gdouble s, gsize n)
+{
+    gsize i = 0;
+
+#ifdef __SSE2__
+    const __m128d vs = _mm_set1_pd(s);
+
+    for (; i + 2 <= n; i += 2)
+        _mm_stream_pd(a + i, _mm_add_pd(_mm_load_pd(b + i), _mm_mul_pd(vs, _mm_load_pd(c + i))));
+    _mm_sfence();
+#endif
+    for (; i < n; i++)
+        a[i] = b[i] + s * c[i];
+}
+
+/* Chunks are multiples of 8 doubles so every chunk stays 16 byte aligned */
+static void
+get_chunk(const StreamRun* run, guint index, gsize* offset, gsize* n)
+{
+    gsize blocks = run->n / 8;
+    gsize first = blocks * index / run->n_threads;
+    gsize last = blocks * (index + 1) / run->n_threads;
+
+    *offset = first * 8;
+    *n = (index + 1 == run->n_threads ? run->n : last * 8) - *offset;
+}
+
+static gpointer
+stream_thread(gpointer user_data)
+{
+    StreamThread* thread = (StreamThread*)user_data;
+    StreamRun* run = thread->run;
+    gsize offset, n;
+
+    get_chunk(run, thread->index, &offset, &n);
+    bench_pin_thread(run->topology->cpus[thread->index % run->topology->n_cpus]);
+
+    run->ready.fetch_add(1);
+    while (!run->go.load())
+        g_thread_yield();
+
+    thread->start = bench_now_ns();
+    if (run->op == OP_INIT)
+    {
+        for (gsize i = offset; i < offset + n; i++)
+        {
+            run->a[i] = 1.0;
+            run->b[i] = 2.0;
+            run->c[i] = 0.0;
+        }
+    }
+    else if (run->op == OP_COPY)
+        stream_copy(run->c + offset, run->a + offset, n);
+    else
+        stream_triad(run->a + offset, run->b + offset, run->c + offset, 3.0, n);
+    thread->end = bench_now_ns();
+
+    return NULL;
+}
+
+/* From the first thread starting to the last one finishing */
+static gint64
+stream_run(StreamOp op, const BenchTopology* topology, gdouble* a, gdouble* b, gdouble* c, gsize n, guint n_threads)
+{
+    StreamThread* threads = g_new0(StreamThread, n_threads);
+    GThread** handles = g_new0(GThread*, n_threads);
+    StreamRun run;
+
+    run.op = op;
+    run.topology = topology;
+    run.a = a;
+    run.b = b;
+    run.c = c;
+    run.n = n;
+    run.n_threads = n_threads;
+    run.ready = 0;
+    run.go = FALSE;
+
+    for (guint i = 0; i < n_threads; i++)
+    {
+        threads[i].run = &run;
+        threads[i].index = i;
+        handles[i] = g_thread_new("calibrate", stream_thread, &threads[i]);
+    }
+
+    while (run.ready.load() < n_threads)
+        g_thread_yield();
+    run.go = TRUE;
+
+    gint64 start = G_MAXINT64, end = 0;
+    for (guint i = 0; i < n_threads; i++)
+    {
+        g_thread_join(handles[i]);
+        start = MIN(start, threads[i].start);
+        end = MAX(end, threads[i].end);
+    }
+
+    g_free(handles);
+    g_free(threads);
+
+    return end - start;
+}
+
+/* Best of TRIALS */
+static gdouble
+stream_bandwidth(StreamOp op, const BenchTopology* topology, gdouble* a, gdouble* b, gdouble* c, gsize n,
+    guint n_threads)
+{
+    gsize bytes = (op == OP_COPY ? 2 : 3) * n * sizeof(gdouble);
+    gint64 best = G_MAXINT64;
+
+    for (guint trial = 0; trial < TRIALS; trial++)
+        best = MIN(best, stream_run(op, topology, a, b, c, n, n_threads));
+
+    return best > 0 ? (gdouble)bytes / best : 0;
+}
+
+static gsize
+cache_size(gint name, gsize fallback)
+{
+    glong size = sysconf(name);
+
+    return size > 0 ? (gsize)size : fallback;
+}
+
+/* The read loops OR the words into eight independent accumulators, an OR
+ * has a latency of one cycle and needs no -ffast-math to be reordered, so
+ * the loads are what limits them. n is a multiple of 32 words */
+typedef guint64 (*ReadFunc)(const guint64* data, gsize n);
+
+#ifndef __SSE2__
+static guint64
+read_scalar(const guint64* data, gsize n)
+{
+    guint64 s[8] = { 0 };
+
+    for (gsize i = 0; i < n; i += 8)
+    {
+        for (guint j = 0; j < 8; j++)
+            s[j] |= data[i + j];
+    }
+
+    return s[0] | s[1] | s[2] | s[3] | s[4] | s[5] | s[6] | s[7];
+}
+#else
+static guint64
+read_sse2(const guint64* data, gsize n)
+{
+    __m128i s0 = _mm_setzero_si128(), s1 = s0, s2 = s0, s3 = s0, s4 = s0, s5 = s0, s6 = s0, s7 = s0;
+    const __m128i* v = (const __m128i*)data;
+
+    for (gsize i = 0; i < n / 2; i += 8)
+    {
+        s0 = _mm_or_si128(s0, _mm_load_si128(v + i));
+        s1 = _mm_or_si128(s1, _mm_load_si128(v + i + 1));
+        s2 = _mm_or_si128(s2, _mm_load_si128(v + i + 2));
+        s3 = _mm_or_si128(s3, _mm_load_si128(v + i + 3));
+        s4 = _mm_or_si128(s4, _mm_load_si128(v + i + 4));
+        s5 = _mm_or_si128(s5, _mm_load_si128(v + i + 5));
+        s6 = _mm_or_si128(s6, _mm_load_si128(v + i + 6));
+        s7 = _mm_or_si128(s7, _mm_load_si128(v + i + 7));
+    }
+
+    __m128i s = _mm_or_si128(_mm_or_si128(_mm_or_si128(s0, s1), _mm_or_si128(s2, s3)),
+        _mm_or_si128(_mm_or_si128(s4, s5), _mm_or_si128(s6, s7)));
+    guint64 words[2];
+
+    _mm_storeu_si128((__m128i*)words, s);
+
+    return words[0] | words[1];
+}
+#endif
+
+#ifdef CALIBRATE_X86
+/* built for AVX2 on its own, the rest of the library stays baseline */
+__attribute__((target("avx2"))) static guint64
+read_avx2(const guint64* data, gsize n)
+{
+    __m256i s0 = _mm256_setzero_si256(), s1 = s0, s2 = s0, s3 = s0, s4 = s0, s5 = s0, s6 = s0, s7 = s0;
+    const __m256i* v = (const __m256i*)data;
+
+    for (gsize i = 0; i < n / 4; i += 8)
+    {
+        s0 = _mm256_or_si256(s0, _mm256_loadu_si256(v + i));
+        s1 = _mm256_or_si256(s1, _mm256_loadu_si256(v + i + 1));
+        s2 = _mm256_or_si256(s2, _mm256_loadu_si256(v + i + 2));
+        s3 = _mm256_or_si256(s3, _mm256_loadu_si256(v + i + 3));
+        s4 = _mm256_or_si256(s4, _mm256_loadu_si256(v + i + 4));
+        s5 = _mm256_or_si256(s5, _mm256_loadu_si256(v + i + 5));
+        s6 = _mm256_or_si256(s6, _mm256_loadu_si256(v + i + 6));
+        s7 = _mm256_or_si256(s7, _mm256_loadu_si256(v + i + 7));
+    }
+
+    __m256i s = _mm256_or_si256(_mm256_or_si256(_mm256_or_si256(s0, s1), _mm256_or_si256(s2, s3)),
+        _mm256_or_si256(_mm256_or_si256(s4, s5), _mm256_or_si256(s6, s7)));
+    guint64 words[4];
+
+    _mm256_storeu_si256((__m256i*)words, s);
+
+    return words[0] | words[1] | words[2] | words[3];
+}
+#endif
+
+static ReadFunc
+get_read_func()
+{
+#ifdef CALIBRATE_X86
+    if (__builtin_cpu_supports("avx2"))
+        return read_avx2;
+#endif
+#ifdef __SSE2__
+    return read_sse2;
+#else
+    return read_scalar;
+#endif
+}
+
+/* Reads a buffer of half the cache size over and over with the widest loads
+ * the CPU has */
+static gdouble
+read_bandwidth(gsize size)
+{
+    ReadFunc read = get_read_func();
+    gsize n = MAX(size / 2 / sizeof(guint64) / 32 * 32, (gsize)32);
+    guint64* buffer = g_new(guint64, n);
+    gsize reps = MAX((gsize)(256 << 20) / (n * sizeof(guint64)), 1);
+    gint64 best = G_MAXINT64;
+    volatile guint64 sink;
+
+    for (gsize i = 0; i < n; i++)
+        buffer[i] = i;
+
+    for (guint trial = 0; trial < TRIALS; trial++)
+    {
+        guint64 s = 0;
+        gint64 start = bench_now_ns();
+
+        for (gsize r = 0; r < reps; r++)
+            s |= read(buffer, n);
+
+        best = MIN(best, bench_now_ns() - start);
+        sink = s;
+    }
+    (void)sink;
+
+    g_free(buffer);
+
+    return best > 0 ? (gdouble)reps * n * sizeof(guint64) / best : 0;
+}
+
+void
+bench_calibration_run(BenchCalibration* calibration)
+{
+    gsize l1 = cache_size(_SC_LEVEL1_DCACHE_SIZE, 32 << 10);
+    gsize l2 = cache_size(_SC_LEVEL2_CACHE_SIZE, 1 << 20);
+    gsize llc = cache_size(_SC_LEVEL3_CACHE_SIZE, l2);
+
+    /* the STREAM rule, every array at least four times the last level cache */
+    gsize n = MAX(4 * llc, (gsize)64 << 20) / sizeof(gdouble);
+    gdouble* a = g_new(gdouble, n);
+    gdouble* b = g_new(gdouble, n);
+    gdouble* c = g_new(gdouble, n);
+    BenchTopology* topology = bench_topology_new();
+
+    memset(calibration, 0, sizeof(BenchCalibration));
+    calibration->threads = topology->n_cpus;
+
+    /* first touched by the thread that streams the chunk on all cores, so
+     * the pages are spread over the nodes like the threads are */
+    stream_run(OP_INIT, topology, a, b, c, n, calibration->threads);
+
+    calibration->copy = stream_bandwidth(OP_COPY, topology, a, b, c, n, 1);
+    calibration->triad = stream_bandwidth(OP_TRIAD, topology, a, b, c, n, 1);
+    calibration->copy_all = stream_bandwidth(OP_COPY, topology, a, b, c, n, calibration->threads);
+    calibration->triad_all = stream_bandwidth(OP_TRIAD, topology, a, b, c, n, calibration->threads);
+
+    g_free(c);
+    g_free(b);
+    g_free(a);
+
+    calibration->l1 = read_bandwidth(l1);
+    calibration->l2 = read_bandwidth(l2);
+    calibration->llc = read_bandwidth(llc);
+
+    bench_topology_free(topology);
+}
+
+static const gchar* group = "calibration";
+
+gboolean
+bench_calibration_load(BenchCalibration* calibration, const gchar* path, GError** error)
+{
+    GKeyFile* key_file = g_key_file_new();
+    gboolean ret = g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, error);
+
+    if (ret)
+    {
+        memset(calibration, 0, sizeof(BenchCalibration));
+        calibration->threads = g_key_file_get_integer(key_file, group, "threads", NULL);
+        calibration->copy = g_key_file_get_double(key_file, group, "copy", NULL);
+        calibration->triad = g_key_file_get_double(key_file, group, "triad", NULL);
+        calibration->copy_all = g_key_file_get_double(key_file, group, "copy-all", NULL);
+        calibration->triad_all = g_key_file_get_double(key_file, group, "triad-all", NULL);
+        calibration->l1 = g_key_file_get_double(key_file, group, "l1", NULL);
+        calibration->l2 = g_key_file_get_double(key_file, group, "l2", NULL);
+        calibration->llc = g_key_file_get_double(key_file, group, "llc", NULL);
+    }
+
+    g_key_file_free(key_file);
+
+    return ret;
+}
+
+gboolean
+bench_calibration_save(const BenchCalibration* calibration, const gchar* path, GError** error)
+{
+    GKeyFile* key_file = g_key_file_new();
+
+    g_key_file_set_integer(key_file, group, "threads", calibration->threads);
+    g_key_file_set_double(key_file, group, "copy", calibration->copy);
+    g_key_file_set_double(key_file, group, "triad", calibration->triad);
+    g_key_file_set_double(key_file, group, "copy-all", calibration->copy_all);
+    g_key_file_set_double(key_file, group, "triad-all", calibration->triad_all);
+    g_key_file_set_double(key_file, group, "l1", calibration->l1);
+    g_key_file_set_double(key_file, group, "l2", calibration->l2);
+    g_key_file_set_double(key_file, group, "llc", calibration->llc);
+
+    gboolean ret = g_key_file_save_to_file(key_file, path, error);
+    g_key_file_free(key_file);
+
+    return ret;
+}
+
+gdouble
+bench_calibration_get_peak(const BenchCalibration* calibration)
+{
+    return MAX(calibration->copy_all, calibration->triad_all);
+}
+
+void
+bench_calibration_report(const BenchCalibration* calibration, BenchReport* report)
+{
+    bench_report_set_info_int(report, "calibration-threads", calibration->threads);
+    bench_report_set_value(report, "Peak Copy", calibration->copy, "GB/s");
+    bench_report_set_value(report, "Peak Triad", calibration->triad, "GB/s");
+    bench_report_set_value(report, "Peak Copy All Cores", calibration->copy_all, "GB/s");
+    bench_report_set_value(report, "Peak Triad All Cores", calibration->triad_all, "GB/s");
+    bench_report_set_value(report, "L1 Read", calibration->l1, "GB/s");
+    bench_report_set_value(report, "L2 Read", calibration->l2, "GB/s");
+    bench_report_set_value(report, "LLC Read", calibration->llc, "GB/s");
+    report->peak = bench_calibration_get_peak(calibration);
+}
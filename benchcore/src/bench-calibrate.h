@@ -0,0 +1,34 @@
+#pragma once
+
+#include <glib.h>
+
+#include "bench-report.h"
+
+typedef struct _BenchCalibration BenchCalibration;
+
+/* Memory bandwidth of the host in GB/s, STREAM copy and triad with
+ * non-temporal stores on one and on all cores, plus single core read
+ * bandwidth out of each cache level */
+struct _BenchCalibration
+{
+    guint threads;
+
+    gdouble copy;
+    gdouble triad;
+    gdouble copy_all;
+    gdouble triad_all;
+
+    gdouble l1;
+    gdouble l2;
+    gdouble llc;
+};
+
+void bench_calibration_run(BenchCalibration* calibration);
+gboolean bench_calibration_load(BenchCalibration* calibration, const gchar* path, GError** error);
+gboolean bench_calibration_save(const BenchCalibration* calibration, const gchar* path, GError** error);
+
+/* The best all core rate, what bench_report_set_bandwidth() compares to */
+gdouble bench_calibration_get_peak(const BenchCalibration* calibration);
+
+/* Adds the calibration as values and sets the peak of the report */
+void bench_calibration_report(const BenchCalibration* calibration, BenchReport* report);
@@ -0,0 +1,267 @@
+#include "bench-recorder.h"
+#include "bench-stats.h"
+
+#include <json-glib/json-glib.h>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+/* Compares the raw samples of a stored report with a fresh one, exits with 1
+ * if any metric got significantly slower and 2 if the reports can not be
+ * compared at all */
+
+typedef struct _Options
+{
+    gdouble alpha;
+    gdouble threshold;
+    gint resamples;
+} Options;
+
+static Options options = { 0.01, 2, 2000 };
+
+static const GOptionEntry entries[] = {
+    { "alpha", 'a', 0, G_OPTION_ARG_DOUBLE, &options.alpha, "Significance level of the Mann-Whitney U test (default 0.01)", "P" },
+    { "threshold", 't', 0, G_OPTION_ARG_DOUBLE, &options.threshold, "Slowdown of the median that counts as regression (default 2)", "PERCENT" },
+    { "resamples", 'r', 0, G_OPTION_ARG_INT, &options.resamples, "Bootstrap resamples of the median ratio (default 2000)", "N" },
+    { NULL }
+};
+
+static JsonParser*
+load_report(const gchar* path, GError** error)
+{
+    JsonParser* parser = json_parser_new();
+
+    if (!json_parser_load_from_file(parser, path, error))
+    {
+        g_object_unref(parser);
+        return NULL;
+    }
+
+    JsonNode* root = json_parser_get_root(parser);
+    if (root == NULL || !JSON_NODE_HOLDS_OBJECT(root) ||
+        !json_object_has_member(json_node_get_object(root), "metrics"))
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is not a benchmark report", path);
+        g_object_unref(parser);
+        return NULL;
+    }
+
+    return parser;
+}
+
+static JsonObject*
+get_report(JsonParser* parser)
+{
+    return json_node_get_object(json_parser_get_root(parser));
+}
+
+/* The newest report of backend in a results store, the names start with the
+ * backend and a sortable timestamp */
+static gchar*
+find_stored(const gchar* store, const gchar* backend, GError** error)
+{
+    GDir* dir = g_dir_open(store, 0, error);
+    gchar* prefix = g_strdup_printf("%s-", backend);
+    gchar* newest = NULL;
+    const gchar* name;
+
+    if (dir == NULL)
+        return NULL;
+
+    while ((name = g_dir_read_name(dir)) != NULL)
+    {
+        if (g_str_has_prefix(name, prefix) && g_str_has_suffix(name, ".json") &&
+            (newest == NULL || g_strcmp0(name, newest) > 0))
+        {
+            g_free(newest);
+            newest = g_strdup(name);
+        }
+    }
+    g_dir_close(dir);
+    g_free(prefix);
+
+    if (newest == NULL)
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT, "no %s report in %s", backend, store);
+        return NULL;
+    }
+
+    gchar* path = g_build_filename(store, newest, NULL);
+    g_free(newest);
+
+    return path;
+}
+
+static JsonObject*
+find_metric(JsonObject* report, const gchar* name)
+{
+    JsonArray* metrics = json_object_get_array_member(report, "metrics");
+
+    for (guint i = 0; i < json_array_get_length(metrics); i++)
+    {
+        JsonObject* metric = json_array_get_object_element(metrics, i);
+
+        if (g_strcmp0(json_object_get_string_member(metric, "name"), name) == 0)
+            return metric;
+    }
+
+    return NULL;
+}
+
+static gint64*
+get_samples(JsonObject* metric, guint* n)
+{
+    JsonArray* array = json_object_get_array_member(metric, "samples");
+
+    *n = json_array_get_length(array);
+
+    gint64* samples = g_new(gint64, MAX(*n, 1));
+    for (guint i = 0; i < *n; i++)
+        samples[i] = json_array_get_int_element(array, i);
+
+    return samples;
+}
+
+static gdouble
+median(const gint64* samples, guint n)
+{
+    gint64* sorted = g_new(gint64, MAX(n, 1));
+
+    std::copy(samples, samples + n, sorted);
+    std::sort(sorted, sorted + n);
+
+    gdouble value = bench_percentile(sorted, n, 0.5);
+    g_free(sorted);
+
+    return value;
+}
+
+/* Library versions, host and the like that differ, a result is only as
+ * comparable as its setup */
+static void
+print_info_changes(JsonObject* baseline, JsonObject* current)
+{
+    if (!json_object_has_member(baseline, "info") || !json_object_has_member(current, "info"))
+        return;
+
+    JsonObject* old_info = json_object_get_object_member(baseline, "info");
+    JsonObject* new_info = json_object_get_object_member(current, "info");
+    GList* keys = json_object_get_members(new_info);
+
+    for (GList* key = keys; key != NULL; key = key->next)
+    {
+        const gchar* name = (const gchar*)key->data;
+        const gchar* now = json_object_get_string_member(new_info, name);
+        const gchar* before = json_object_has_member(old_info, name) ? json_object_get_string_member(old_info, name) : "-";
+
+        if (g_strcmp0(before, now) != 0)
+            std::cout << name << ": " << before << " -> " << now << std::endl;
+    }
+
+    g_list_free(keys);
+}
+
+int
+main(int argc, char* argv[])
+{
+    GOptionContext* context = g_option_context_new("BASELINE CURRENT - compare benchmark reports");
+    GError* error = NULL;
+
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_set_description(context,
+        "BASELINE is a report or a results store, which stands for its newest report of the same backend.");
+    if (!g_option_context_parse(context, &argc, &argv, &error) || argc != 3)
+    {
+        g_printerr("%s\n", error != NULL ? error->message : "expected BASELINE and CURRENT");
+        g_option_context_free(context);
+        return 2;
+    }
+    g_option_context_free(context);
+
+    JsonParser* current_parser = load_report(argv[2], &error);
+    if (current_parser == NULL)
+    {
+        g_printerr("%s\n", error->message);
+        return 2;
+    }
+    JsonObject* current = get_report(current_parser);
+    const gchar* backend = json_object_get_string_member(current, "backend");
+
+    gchar* baseline_path = g_file_test(argv[1], G_FILE_TEST_IS_DIR) ?
+        find_stored(argv[1], backend, &error) : g_strdup(argv[1]);
+    JsonParser* baseline_parser = baseline_path != NULL ? load_report(baseline_path, &error) : NULL;
+    if (baseline_parser == NULL)
+    {
+        g_printerr("%s\n", error->message);
+        return 2;
+    }
+    JsonObject* baseline = get_report(baseline_parser);
+
+    std::cout << "Baseline: " << baseline_path << std::endl;
+    print_info_changes(baseline, current);
+
+    /* fixed seed, the same reports always give the same verdict */
+    GRand* rand = g_rand_new_with_seed(42);
+    JsonArray* metrics = json_object_get_array_member(current, "metrics");
+    guint compared = 0, regressions = 0;
+
+    for (guint i = 0; i < json_array_get_length(metrics); i++)
+    {
+        JsonObject* metric = json_array_get_object_element(metrics, i);
+        const gchar* name = json_object_get_string_member(metric, "name");
+        JsonObject* old_metric = find_metric(baseline, name);
+
+        /* only durations, lower is better for all of them */
+        if (old_metric == NULL || g_strcmp0(json_object_get_string_member(metric, "unit"), "ns") != 0)
+            continue;
+
+        guint n_old, n_new;
+        gint64* old_samples = get_samples(old_metric, &n_old);
+        gint64* new_samples = get_samples(metric, &n_new);
+
+        if (n_old > 0 && n_new > 0)
+        {
+            gdouble old_median = median(old_samples, n_old);
+            gdouble new_median = median(new_samples, n_new);
+            gdouble change = old_median > 0 ? 100 * (new_median / old_median - 1) : 0;
+            gdouble p = bench_mann_whitney(old_samples, n_old, new_samples, n_new);
+            gdouble low, high;
+
+            bench_bootstrap_median_ratio(old_samples, n_old, new_samples, n_new, options.resamples, 0.95, rand, &low, &high);
+
+            /* both tests have to agree, and the slowdown has to matter */
+            gboolean slower = p < options.alpha && low > 1;
+            gboolean faster = 1 - p < options.alpha && high < 1;
+            gboolean regression = slower && change > options.threshold;
+
+            std::cout << std::fixed << std::setprecision(3)
+                      << name << ": " << old_median / 1e6 << " ms -> " << new_median / 1e6 << " ms ("
+                      << std::showpos << std::setprecision(1) << change << std::noshowpos << "%)"
+                      << std::setprecision(4) << ", p " << p
+                      << ", ratio CI95 [" << low << ", " << high << "]"
+                      << (regression ? " REGRESSION" : faster ? " faster" : slower ? " slower" : "") << std::endl;
+
+            compared++;
+            if (regression)
+                regressions++;
+        }
+
+        g_free(new_samples);
+        g_free(old_samples);
+    }
+
+    g_rand_free(rand);
+    g_object_unref(baseline_parser);
+    g_object_unref(current_parser);
+    g_free(baseline_path);
+
+    if (compared == 0)
+    {
+        g_printerr("no metric in common\n");
+        return 2;
+    }
+
+    std::cout << regressions << " of " << compared << " metrics regressed" << std::endl;
+
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,42 @@
+#include "bench-geometry.h"
+
+static const gchar* format_names[BENCH_N_FORMATS] = { "GRAY8", "GRAY16", "RGBA", "FLOAT32" };
+static const guint format_bpp[BENCH_N_FORMATS] = { 1, 2, 4, 4 };
+
+const gchar*
+bench_format_to_string(BenchFormat format)
+{
+    g_return_val_if_fail(format < BENCH_N_FORMATS, NULL);
+
+    return format_names[format];
+}
+
+gboolean
+bench_format_from_string(const gchar* str, BenchFormat* format)
+{
+    for (guint i = 0; i < BENCH_N_FORMATS; i++)
+    {
+        if (g_ascii_strcasecmp(str, format_names[i]) == 0)
+        {
+            *format = (BenchFormat)i;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+guint
+bench_format_get_bpp(BenchFormat format)
+{
+    g_return_val_if_fail(format < BENCH_N_FORMATS, 0);
+
+    return format_bpp[format];
+}
+
+gchar*
+bench_geometry_to_string(const BenchGeometry* geometry)
+{
+    return g_strdup_printf("%ux%u %s n=%u", geometry->width, geometry->height,
+        bench_format_to_string(geometry->format), geometry->number);
+}
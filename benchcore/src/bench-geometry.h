@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glib.h>
+
+typedef enum
+{
+    BENCH_FORMAT_GRAY8,
+    BENCH_FORMAT_GRAY16,
+    BENCH_FORMAT_RGBA,
+    BENCH_FORMAT_FLOAT32,
+    BENCH_N_FORMATS,
+} BenchFormat;
+
+typedef struct _BenchGeometry BenchGeometry;
+
+/* Shape of one batch of frames */
+struct _BenchGeometry
+{
+    guint width;
+    guint height;
+    guint number;
+    BenchFormat format;
+};
+
+const gchar* bench_format_to_string(BenchFormat format);
+gboolean bench_format_from_string(const gchar* str, BenchFormat* format);
+guint bench_format_get_bpp(BenchFormat format);
+
+static inline gsize
+bench_geometry_frame_size(const BenchGeometry* geometry)
+{
+    return (gsize)geometry->width * geometry->height * bench_format_get_bpp(geometry->format);
+}
+
+static inline gsize
+bench_geometry_batch_size(const BenchGeometry* geometry)
+{
+    return bench_geometry_frame_size(geometry) * geometry->number;
+}
+
+gchar* bench_geometry_to_string(const BenchGeometry* geometry);
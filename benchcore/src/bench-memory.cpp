@@ -0,0 +1,190 @@
+#include "bench-memory.h"
+
+#include <sys/resource.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+
+static std::atomic<bool> counting;
+static std::atomic<gint64> mallocs;
+static std::atomic<gint64> frees;
+static std::atomic<gint64> malloc_bytes;
+
+static inline void
+count_malloc(void* ptr, size_t size)
+{
+    if (ptr != NULL && counting.load(std::memory_order_relaxed))
+    {
+        mallocs.fetch_add(1, std::memory_order_relaxed);
+        malloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+}
+
+static inline void
+count_free(void* ptr)
+{
+    if (ptr != NULL && counting.load(std::memory_order_relaxed))
+        frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+#ifdef __GLIBC__
+/* The executable's definitions come before libc's for every library, glibc
+ * exports the real implementations under these names */
+extern "C"
+{
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+void*
+malloc(size_t size) __THROW
+{
+    void* ptr = __libc_malloc(size);
+
+    count_malloc(ptr, size);
+
+    return ptr;
+}
+
+void*
+calloc(size_t n, size_t size) __THROW
+{
+    void* ptr = __libc_calloc(n, size);
+
+    count_malloc(ptr, n * size);
+
+    return ptr;
+}
+
+/* a move is a free and a fresh allocation */
+void*
+realloc(void* ptr, size_t size) __THROW
+{
+    void* result = __libc_realloc(ptr, size);
+
+    if (ptr != NULL && (size == 0 || result != NULL))
+        count_free(ptr);
+    count_malloc(result, size);
+
+    return result;
+}
+
+void*
+memalign(size_t alignment, size_t size) __THROW
+{
+    void* ptr = __libc_memalign(alignment, size);
+
+    count_malloc(ptr, size);
+
+    return ptr;
+}
+
+void*
+aligned_alloc(size_t alignment, size_t size) __THROW
+{
+    return memalign(alignment, size);
+}
+
+int
+posix_memalign(void** result, size_t alignment, size_t size) __THROW
+{
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+
+    void* ptr = memalign(alignment, size);
+    if (ptr == NULL)
+        return ENOMEM;
+
+    *result = ptr;
+
+    return 0;
+}
+
+void
+free(void* ptr) __THROW
+{
+    count_free(ptr);
+    __libc_free(ptr);
+}
+}
+#endif
+
+gboolean
+bench_memory_enable()
+{
+#ifdef __GLIBC__
+    counting = true;
+
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+/* Resident pages from statm, getrusage only knows the peak. Plain read()
+ * instead of stdio, which would show up in the malloc counters */
+static gint64
+current_rss()
+{
+    gchar buf[128];
+    long size = 0, resident = 0;
+    gint fd = open("/proc/self/statm", O_RDONLY);
+
+    if (fd < 0)
+        return 0;
+
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+
+    if (n <= 0)
+        return 0;
+    buf[n] = '\0';
+
+    if (sscanf(buf, "%ld %ld", &size, &resident) != 2)
+        return 0;
+
+    return (gint64)resident * sysconf(_SC_PAGESIZE);
+}
+
+void
+bench_memory_sample(BenchMemorySample* sample)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    sample->minor_faults = usage.ru_minflt;
+    sample->major_faults = usage.ru_majflt;
+    sample->rss = current_rss();
+    sample->mallocs = mallocs.load(std::memory_order_relaxed);
+    sample->frees = frees.load(std::memory_order_relaxed);
+    sample->malloc_bytes = malloc_bytes.load(std::memory_order_relaxed);
+}
+
+void
+bench_memory_delta(const BenchMemorySample* before, const BenchMemorySample* after, BenchMemorySample* delta)
+{
+    delta->minor_faults = after->minor_faults - before->minor_faults;
+    delta->major_faults = after->major_faults - before->major_faults;
+    delta->rss = after->rss - before->rss;
+    delta->mallocs = after->mallocs - before->mallocs;
+    delta->frees = after->frees - before->frees;
+    delta->malloc_bytes = after->malloc_bytes - before->malloc_bytes;
+}
+
+gint64
+bench_memory_peak_rss()
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    /* in KiB on Linux */
+    return (gint64)usage.ru_maxrss * 1024;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glib.h>
+
+typedef struct _BenchMemorySample BenchMemorySample;
+
+/* Process wide memory counters at one point in time, or the difference of
+ * two of them. The malloc counters only move after bench_memory_enable() */
+struct _BenchMemorySample
+{
+    gint64 minor_faults;
+    gint64 major_faults;
+    gint64 rss;
+    gint64 mallocs;
+    gint64 frees;
+    gint64 malloc_bytes;
+};
+
+/* Starts counting malloc and free, FALSE if the allocator can not be hooked
+ * on this libc */
+gboolean bench_memory_enable();
+
+void bench_memory_sample(BenchMemorySample* sample);
+void bench_memory_delta(const BenchMemorySample* before, const BenchMemorySample* after, BenchMemorySample* delta);
+
+/* Peak resident set size of the process in bytes */
+gint64 bench_memory_peak_rss();
@@ -0,0 +1,407 @@
+#include "bench-perf.h"
+#include "bench-thread.h"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+typedef struct _Event
+{
+    const gchar* name;
+    guint32 type;
+    guint64 config;
+} Event;
+
+static const Event events[BENCH_N_PERF_COUNTERS] = {
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "LLC misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { "dTLB misses", PERF_TYPE_HW_CACHE,
+      PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { "context switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+};
+
+/* Raw values of one group read, enabled and running differ once the kernel
+ * multiplexes the group with others */
+typedef struct _Counts
+{
+    guint64 values[BENCH_N_PERF_COUNTERS];
+    guint64 enabled;
+    guint64 running;
+} Counts;
+
+typedef struct _Thread
+{
+    pid_t tid;
+    gint fds[BENCH_N_PERF_COUNTERS];
+    gint leader;
+    gchar name[16];
+    Counts base;
+} Thread;
+
+struct _BenchPerf
+{
+    /* counters the kernel opened in bench_perf_new() */
+    guint mask;
+    gboolean kernel;
+
+    GMutex lock;
+    GPtrArray* threads;
+
+    /* scaled counts since the last report, in total and per thread name */
+    gdouble total[BENCH_N_PERF_COUNTERS];
+    GHashTable* names;
+    guint iterations;
+};
+
+static gint
+open_counter(BenchPerfCounter counter, pid_t tid, gint leader, gboolean kernel)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[counter].type;
+    attr.config = events[counter].config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = !kernel;
+    attr.exclude_hv = 1;
+
+    return (gint)syscall(SYS_perf_event_open, &attr, tid, -1, leader, PERF_FLAG_FD_CLOEXEC);
+}
+
+static void
+close_thread(Thread* thread)
+{
+    for (guint i = 0; i < BENCH_N_PERF_COUNTERS; i++)
+    {
+        if (thread->fds[i] >= 0)
+            close(thread->fds[i]);
+    }
+
+    g_free(thread);
+}
+
+static void
+read_name(Thread* thread)
+{
+    gchar* path = g_strdup_printf("/proc/self/task/%d/comm", (gint)thread->tid);
+    gchar* contents = NULL;
+
+    if (g_file_get_contents(path, &contents, NULL, NULL))
+        g_strlcpy(thread->name, g_strstrip(contents), sizeof(thread->name));
+
+    g_free(contents);
+    g_free(path);
+}
+
+static gboolean
+read_counts(const BenchPerf* perf, const Thread* thread, Counts* counts)
+{
+    guint64 buffer[3 + BENCH_N_PERF_COUNTERS];
+    guint k = 0;
+
+    memset(counts, 0, sizeof(*counts));
+    if (read(thread->leader, buffer, sizeof(buffer)) < (ssize_t)(3 * sizeof(guint64)))
+        return FALSE;
+
+    /* the group reads back in the order the counters were opened */
+    counts->enabled = buffer[1];
+    counts->running = buffer[2];
+    for (guint i = 0; i < BENCH_N_PERF_COUNTERS && k < buffer[0]; i++)
+    {
+        if (perf->mask & (1 << i))
+            counts->values[i] = buffer[3 + k++];
+    }
+
+    return TRUE;
+}
+
+/* tid 0 is the calling thread. Needs the lock, the thread may be running */
+static void
+add_thread(BenchPerf* perf, pid_t tid)
+{
+    Thread* thread = g_new0(Thread, 1);
+
+    thread->tid = tid != 0 ? tid : (pid_t)syscall(SYS_gettid);
+    thread->leader = -1;
+    g_strlcpy(thread->name, "unknown", sizeof(thread->name));
+
+    for (guint i = 0; i < BENCH_N_PERF_COUNTERS; i++)
+    {
+        thread->fds[i] = -1;
+        if (!(perf->mask & (1 << i)))
+            continue;
+
+        thread->fds[i] = open_counter((BenchPerfCounter)i, tid, thread->leader, perf->kernel);
+        if (thread->fds[i] < 0)
+        {
+            close_thread(thread);
+            return;
+        }
+        if (thread->leader < 0)
+            thread->leader = thread->fds[i];
+    }
+
+    read_name(thread);
+    read_counts(perf, thread, &thread->base);
+    g_ptr_array_add(perf->threads, thread);
+}
+
+/* Every thread that starts after bench_perf_new() gets its own group before
+ * it runs any code of its creator */
+static void
+thread_started(gpointer user_data)
+{
+    BenchPerf* perf = (BenchPerf*)user_data;
+
+    g_mutex_lock(&perf->lock);
+    add_thread(perf, 0);
+    g_mutex_unlock(&perf->lock);
+}
+
+/* Finds the counters the kernel hands out, with the kernel part of the
+ * threads if perf_event_paranoid allows it */
+static gboolean
+probe(BenchPerf* perf, GError** error)
+{
+    gint first_error = 0;
+
+    for (gint kernel = 1; kernel >= 0 && perf->mask == 0; kernel--)
+    {
+        for (guint i = 0; i < BENCH_N_PERF_COUNTERS; i++)
+        {
+            gint fd = open_counter((BenchPerfCounter)i, 0, -1, kernel);
+
+            if (fd >= 0)
+            {
+                perf->mask |= 1 << i;
+                close(fd);
+            }
+            else if (first_error == 0)
+                first_error = errno;
+        }
+
+        perf->kernel = kernel;
+    }
+
+    /* switches happen in the kernel, a user only count is always 0 */
+    if (!perf->kernel)
+        perf->mask &= ~(1 << BENCH_PERF_CONTEXT_SWITCHES);
+
+    if (perf->mask == 0)
+    {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(first_error),
+            "perf_event_open failed: %s, see /proc/sys/kernel/perf_event_paranoid", g_strerror(first_error));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+BenchPerf*
+bench_perf_new(GError** error)
+{
+    BenchPerf* perf = g_new0(BenchPerf, 1);
+
+    g_mutex_init(&perf->lock);
+    perf->threads = g_ptr_array_new_with_free_func((GDestroyNotify)close_thread);
+    perf->names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+    if (!probe(perf, error))
+    {
+        bench_perf_free(perf);
+        return NULL;
+    }
+
+    GDir* dir = g_dir_open("/proc/self/task", 0, NULL);
+    const gchar* name;
+
+    g_mutex_lock(&perf->lock);
+    while (dir != NULL && (name = g_dir_read_name(dir)) != NULL)
+        add_thread(perf, (pid_t)atoi(name));
+    g_mutex_unlock(&perf->lock);
+
+    if (dir != NULL)
+        g_dir_close(dir);
+
+    bench_thread_add_start_hook(thread_started, perf);
+
+    return perf;
+}
+
+void
+bench_perf_free(BenchPerf* perf)
+{
+    bench_thread_remove_start_hook(thread_started, perf);
+
+    g_ptr_array_unref(perf->threads);
+    g_hash_table_unref(perf->names);
+    g_mutex_clear(&perf->lock);
+    g_free(perf);
+}
+
+gboolean
+bench_perf_has_counter(const BenchPerf* perf, BenchPerfCounter counter)
+{
+    return (perf->mask & (1 << counter)) != 0;
+}
+
+void
+bench_perf_begin(BenchPerf* perf)
+{
+    g_mutex_lock(&perf->lock);
+    for (guint i = 0; i < perf->threads->len; i++)
+    {
+        Thread* thread = (Thread*)g_ptr_array_index(perf->threads, i);
+
+        read_counts(perf, thread, &thread->base);
+    }
+    g_mutex_unlock(&perf->lock);
+}
+
+void
+bench_perf_end(BenchPerf* perf)
+{
+    g_mutex_lock(&perf->lock);
+
+    for (guint i = 0; i < perf->threads->len;)
+    {
+        Thread* thread = (Thread*)g_ptr_array_index(perf->threads, i);
+        Counts now;
+
+        /* the counters of a thread that is gone still read its last values */
+        gchar* path = g_strdup_printf("/proc/self/task/%d", (gint)thread->tid);
+        gboolean alive = g_file_test(path, G_FILE_TEST_EXISTS);
+        g_free(path);
+
+        if (alive)
+            read_name(thread);
+
+        if (read_counts(perf, thread, &now))
+        {
+            guint64 enabled = now.enabled - thread->base.enabled;
+            guint64 running = now.running - thread->base.running;
+            gdouble scale = running > 0 ? (gdouble)enabled / running : 1;
+            gdouble* named = (gdouble*)g_hash_table_lookup(perf->names, thread->name);
+
+            if (named == NULL)
+            {
+                named = g_new0(gdouble, BENCH_N_PERF_COUNTERS);
+                g_hash_table_insert(perf->names, g_strdup(thread->name), named);
+            }
+
+            for (guint c = 0; c < BENCH_N_PERF_COUNTERS; c++)
+            {
+                gdouble delta = (now.values[c] - thread->base.values[c]) * scale;
+
+                perf->total[c] += delta;
+                named[c] += delta;
+            }
+            thread->base = now;
+        }
+
+        if (alive)
+            i++;
+        else
+            g_ptr_array_remove_index_fast(perf->threads, i);
+    }
+
+    perf->iterations++;
+
+    g_mutex_unlock(&perf->lock);
+}
+
+static gdouble
+ratio(gdouble a, gdouble b)
+{
+    return b > 0 ? a / b : 0;
+}
+
+void
+bench_perf_report(BenchPerf* perf, BenchReport* report, const gchar* name, gdouble bytes)
+{
+    const gdouble* total = perf->total;
+    guint n = perf->iterations;
+
+    if (n == 0)
+        return;
+
+    for (guint c = 0; c < BENCH_N_PERF_COUNTERS; c++)
+    {
+        if (!bench_perf_has_counter(perf, (BenchPerfCounter)c))
+            continue;
+
+        gchar* value = g_strdup_printf("%s %s", name, events[c].name);
+        bench_report_set_value(report, value, total[c] / n, "per iteration");
+        g_free(value);
+    }
+
+    gboolean ipc = bench_perf_has_counter(perf, BENCH_PERF_CYCLES) && bench_perf_has_counter(perf, BENCH_PERF_INSTRUCTIONS);
+    gchar* value;
+
+    /* below 1 the cores mostly wait, on memory if the LLC misses are high */
+    if (ipc)
+    {
+        value = g_strdup_printf("%s IPC", name);
+        bench_report_set_value(report, value, ratio(total[BENCH_PERF_INSTRUCTIONS], total[BENCH_PERF_CYCLES]), "");
+        g_free(value);
+    }
+
+    /* a cache line per miss is a pure stream, much less means the misses are
+     * not the data moved */
+    if (bench_perf_has_counter(perf, BENCH_PERF_LLC_MISSES) && bytes > 0)
+    {
+        value = g_strdup_printf("%s bytes per LLC miss", name);
+        bench_report_set_value(report, value, ratio(bytes * n, total[BENCH_PERF_LLC_MISSES]), "B");
+        g_free(value);
+    }
+
+    if (bench_perf_has_counter(perf, BENCH_PERF_DTLB_MISSES) && bench_perf_has_counter(perf, BENCH_PERF_INSTRUCTIONS))
+    {
+        value = g_strdup_printf("%s dTLB misses per 1k instructions", name);
+        bench_report_set_value(report, value, 1000 * ratio(total[BENCH_PERF_DTLB_MISSES], total[BENCH_PERF_INSTRUCTIONS]), "");
+        g_free(value);
+    }
+
+    /* busiest threads first */
+    GList* names = g_hash_table_get_keys(perf->names);
+    BenchPerfCounter key = bench_perf_has_counter(perf, BENCH_PERF_CYCLES) ? BENCH_PERF_CYCLES : BENCH_PERF_CONTEXT_SWITCHES;
+    std::vector<const gchar*> sorted;
+
+    for (GList* it = names; it != NULL; it = it->next)
+        sorted.push_back((const gchar*)it->data);
+    std::sort(sorted.begin(), sorted.end(), [perf, key](const gchar* a, const gchar* b) {
+        return ((gdouble*)g_hash_table_lookup(perf->names, a))[key] > ((gdouble*)g_hash_table_lookup(perf->names, b))[key];
+    });
+
+    for (const gchar* thread : sorted)
+    {
+        const gdouble* counts = (const gdouble*)g_hash_table_lookup(perf->names, thread);
+
+        if (counts[key] <= 0)
+            continue;
+
+        value = g_strdup_printf("%s thread %s %s", name, thread, events[key].name);
+        bench_report_set_value(report, value, 100 * ratio(counts[key], total[key]), "%");
+        g_free(value);
+
+        if (ipc)
+        {
+            value = g_strdup_printf("%s thread %s IPC", name, thread);
+            bench_report_set_value(report, value, ratio(counts[BENCH_PERF_INSTRUCTIONS], counts[BENCH_PERF_CYCLES]), "");
+            g_free(value);
+        }
+    }
+
+    g_list_free(names);
+
+    memset(perf->total, 0, sizeof(perf->total));
+    g_hash_table_remove_all(perf->names);
+    perf->iterations = 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glib.h>
+
+#include "bench-report.h"
+
+typedef enum
+{
+    BENCH_PERF_CYCLES,
+    BENCH_PERF_INSTRUCTIONS,
+    BENCH_PERF_LLC_MISSES,
+    BENCH_PERF_DTLB_MISSES,
+    BENCH_PERF_CONTEXT_SWITCHES,
+    BENCH_N_PERF_COUNTERS,
+} BenchPerfCounter;
+
+typedef struct _BenchPerf BenchPerf;
+
+/* Hardware counters of every thread of the process through perf_event_open,
+ * one counter group per thread. Threads that exist already are picked up
+ * here, later ones as they start, see bench_thread_add_start_hook().
+ * Fails if the kernel hands out none of the counters, counters it does not
+ * have are left out */
+BenchPerf* bench_perf_new(GError** error);
+void bench_perf_free(BenchPerf* perf);
+
+gboolean bench_perf_has_counter(const BenchPerf* perf, BenchPerfCounter counter);
+
+/* Counts whatever all threads do between begin and end, bench_run() calls
+ * them around every iteration */
+void bench_perf_begin(BenchPerf* perf);
+void bench_perf_end(BenchPerf* perf);
+
+/* Adds per iteration counts, IPC, bytes per LLC miss and the dTLB miss rate
+ * of everything counted since the last report under name, plus the cycle
+ * share and IPC per thread name. bytes is what one iteration moves */
+void bench_perf_report(BenchPerf* perf, BenchReport* report, const gchar* name, gdouble bytes);
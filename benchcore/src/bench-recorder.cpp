@@ -0,0 +1,256 @@
+#include "bench-recorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+BenchRecorder*
+bench_recorder_new(const gchar* name, guint capacity)
+{
+    BenchRecorder* recorder = g_new0(BenchRecorder, 1);
+
+    recorder->name = g_strdup(name);
+    recorder->unit = g_strdup("ns");
+    recorder->capacity = capacity;
+    recorder->samples = g_new(gint64, capacity);
+
+    /* touch every page now instead of during the first measured iterations */
+    memset(recorder->samples, 0, sizeof(gint64) * capacity);
+
+    return recorder;
+}
+
+void
+bench_recorder_free(BenchRecorder* recorder)
+{
+    g_free(recorder->memory);
+    g_free(recorder->samples);
+    g_free(recorder->unit);
+    g_free(recorder->name);
+    g_free(recorder);
+}
+
+void
+bench_recorder_reset(BenchRecorder* recorder)
+{
+    recorder->n_samples = 0;
+    recorder->dropped = 0;
+    recorder->adaptive = FALSE;
+    recorder->warmup = 0;
+    recorder->outliers = 0;
+    recorder->ci_low = recorder->ci_high = 0;
+}
+
+void
+bench_recorder_enable_memory(BenchRecorder* recorder)
+{
+    if (recorder->memory != NULL)
+        return;
+
+    /* zeroed up front like the samples */
+    recorder->memory = g_new0(BenchMemorySample, recorder->capacity);
+}
+
+/* Removes n samples from start on, keeping the memory deltas in step */
+void
+bench_recorder_discard(BenchRecorder* recorder, guint start, guint n)
+{
+    guint rest = recorder->n_samples - start - n;
+
+    memmove(recorder->samples + start, recorder->samples + start + n, sizeof(gint64) * rest);
+    if (recorder->memory != NULL)
+        memmove(recorder->memory + start, recorder->memory + start + n, sizeof(BenchMemorySample) * rest);
+    recorder->n_samples -= n;
+}
+
+void
+bench_recorder_set_unit(BenchRecorder* recorder, const gchar* unit)
+{
+    g_free(recorder->unit);
+    recorder->unit = g_strdup(unit);
+}
+
+/* Linear interpolation between the closest ranks, p in [0, 1] */
+gdouble
+bench_percentile(const gint64* sorted, guint n, gdouble p)
+{
+    if (n == 0)
+        return 0;
+
+    gdouble rank = p * (n - 1);
+    guint lower = (guint)std::floor(rank);
+    guint upper = std::min(lower + 1, n - 1);
+    gdouble frac = rank - lower;
+
+    return sorted[lower] + frac * (sorted[upper] - sorted[lower]);
+}
+
+/* MSER-5: the truncation of the first batches of 5 samples that minimises
+ * the standard error of the mean of the rest. Only the first half is ever
+ * cut, so a run that never settles is kept whole */
+guint
+bench_warmup_length(const gint64* samples, guint n)
+{
+    const guint batch = 5;
+    guint k = n / batch;
+
+    if (k < 4)
+        return 0;
+
+    /* suffix sums of the batch means and their squares */
+    gdouble* sum = g_new0(gdouble, k + 1);
+    gdouble* sum2 = g_new0(gdouble, k + 1);
+
+    for (guint b = k; b-- > 0;)
+    {
+        gdouble mean = 0;
+
+        for (guint i = 0; i < batch; i++)
+            mean += samples[b * batch + i];
+        mean /= batch;
+
+        sum[b] = sum[b + 1] + mean;
+        sum2[b] = sum2[b + 1] + mean * mean;
+    }
+
+    guint best = 0;
+    gdouble best_mser = G_MAXDOUBLE;
+
+    for (guint d = 0; d <= k / 2; d++)
+    {
+        gdouble m = k - d;
+        gdouble mser = (sum2[d] - sum[d] * sum[d] / m) / (m * m);
+
+        if (mser < best_mser)
+        {
+            best_mser = mser;
+            best = d;
+        }
+    }
+
+    g_free(sum2);
+    g_free(sum);
+
+    return best * batch;
+}
+
+/* Distribution free 95% confidence interval of the median from the order
+ * statistics around it, FALSE if there are too few samples */
+gboolean
+bench_median_ci(const gint64* sorted, guint n, gdouble* low, gdouble* high)
+{
+    if (n < 6)
+        return FALSE;
+
+    gdouble spread = 0.98 * std::sqrt((gdouble)n);
+    gint lower = (gint)std::floor(n / 2.0 - spread);
+    gint upper = (gint)std::ceil(n / 2.0 + spread);
+
+    /* 1-based ranks */
+    *low = sorted[CLAMP(lower, 1, (gint)n) - 1];
+    *high = sorted[CLAMP(upper, 1, (gint)n) - 1];
+
+    return TRUE;
+}
+
+/* Samples beyond Tukey's outer fences, 3 IQR outside the quartiles */
+guint
+bench_count_outliers(const gint64* sorted, guint n)
+{
+    if (n < 4)
+        return 0;
+
+    gdouble q1 = bench_percentile(sorted, n, 0.25);
+    gdouble q3 = bench_percentile(sorted, n, 0.75);
+    gdouble iqr = q3 - q1;
+    guint outliers = 0;
+
+    for (guint i = 0; i < n; i++)
+    {
+        if (sorted[i] < q1 - 3 * iqr || sorted[i] > q3 + 3 * iqr)
+            outliers++;
+    }
+
+    return outliers;
+}
+
+void
+bench_recorder_compute_stats(const BenchRecorder* recorder, BenchStats* stats)
+{
+    guint n = recorder->n_samples;
+
+    memset(stats, 0, sizeof(BenchStats));
+    stats->n = n;
+
+    if (n == 0)
+        return;
+
+    gint64* sorted = g_new(gint64, n);
+    memcpy(sorted, recorder->samples, sizeof(gint64) * n);
+    std::sort(sorted, sorted + n);
+
+    gdouble sum = 0;
+    for (guint i = 0; i < n; i++)
+    {
+        sum += sorted[i];
+    }
+    stats->mean = sum / n;
+
+    gdouble sum2 = 0;
+    for (guint i = 0; i < n; i++)
+    {
+        sum2 += std::pow(sorted[i] - stats->mean, 2);
+    }
+    stats->stddev = n > 1 ? std::sqrt(sum2 / (n - 1)) : 0;
+
+    stats->min = sorted[0];
+    stats->max = sorted[n - 1];
+    stats->p50 = bench_percentile(sorted, n, 0.5);
+    stats->p90 = bench_percentile(sorted, n, 0.9);
+    stats->p99 = bench_percentile(sorted, n, 0.99);
+    stats->p999 = bench_percentile(sorted, n, 0.999);
+
+    g_free(sorted);
+}
+
+/* Values below BENCH_HISTOGRAM_SUB_COUNT get one bucket each, above that every
+ * power of two is split into BENCH_HISTOGRAM_SUB_COUNT linear sub-buckets, so
+ * the relative error stays constant over the whole range like in HdrHistogram */
+guint
+bench_histogram_index(gint64 value)
+{
+    if (value < BENCH_HISTOGRAM_SUB_COUNT)
+        return value < 0 ? 0 : (guint)value;
+
+    guint msb = 63 - __builtin_clzll((guint64)value);
+    guint shift = msb - BENCH_HISTOGRAM_SUB_BITS;
+    guint sub = (guint)(value >> shift) & (BENCH_HISTOGRAM_SUB_COUNT - 1);
+
+    return (shift + 1) * BENCH_HISTOGRAM_SUB_COUNT + sub;
+}
+
+gint64
+bench_histogram_lower_bound(guint index)
+{
+    if (index < BENCH_HISTOGRAM_SUB_COUNT)
+        return index;
+    if (index >= BENCH_HISTOGRAM_BUCKETS)
+        return G_MAXINT64;
+
+    guint shift = index / BENCH_HISTOGRAM_SUB_COUNT - 1;
+    guint sub = index % BENCH_HISTOGRAM_SUB_COUNT;
+
+    return (gint64)(BENCH_HISTOGRAM_SUB_COUNT + sub) << shift;
+}
+
+/* buckets must hold BENCH_HISTOGRAM_BUCKETS entries */
+void
+bench_recorder_histogram(const BenchRecorder* recorder, guint64* buckets)
+{
+    memset(buckets, 0, sizeof(guint64) * BENCH_HISTOGRAM_BUCKETS);
+
+    for (guint i = 0; i < recorder->n_samples; i++)
+    {
+        buckets[bench_histogram_index(recorder->samples[i])]++;
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glib.h>
+#include <chrono>
+
+#include "bench-memory.h"
+
+/* Sub-buckets per power of two in the histogram, 2^4 = 16 gives ~6% resolution */
+#define BENCH_HISTOGRAM_SUB_BITS 4
+#define BENCH_HISTOGRAM_SUB_COUNT (1 << BENCH_HISTOGRAM_SUB_BITS)
+#define BENCH_HISTOGRAM_BUCKETS ((64 - BENCH_HISTOGRAM_SUB_BITS) * BENCH_HISTOGRAM_SUB_COUNT)
+
+typedef struct _BenchRecorder BenchRecorder;
+typedef struct _BenchStats BenchStats;
+
+/* Raw nanosecond samples of one metric, stored in a buffer that is allocated
+ * up front so recording never allocates inside the measured loop */
+struct _BenchRecorder
+{
+    gchar* name;
+    gchar* unit;
+
+    gint64* samples;
+    guint capacity;
+    guint n_samples;
+    guint dropped;
+
+    /* filled in by an adaptive bench_run(), warmup samples are not kept */
+    gboolean adaptive;
+    guint warmup;
+    guint outliers;
+    gdouble ci_low;
+    gdouble ci_high;
+
+    /* memory counter deltas per sample, NULL unless bench_run() measures them */
+    BenchMemorySample* memory;
+};
+
+struct _BenchStats
+{
+    guint n;
+    gdouble mean;
+    gdouble stddev;
+    gint64 min;
+    gint64 max;
+    gdouble p50;
+    gdouble p90;
+    gdouble p99;
+    gdouble p999;
+};
+
+static inline gint64
+bench_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+BenchRecorder* bench_recorder_new(const gchar* name, guint capacity);
+void bench_recorder_free(BenchRecorder* recorder);
+void bench_recorder_reset(BenchRecorder* recorder);
+
+static inline void
+bench_recorder_add(BenchRecorder* recorder, gint64 value)
+{
+    if (recorder->n_samples < recorder->capacity)
+        recorder->samples[recorder->n_samples++] = value;
+    else
+        recorder->dropped++;
+}
+
+static inline void
+bench_recorder_add_memory(BenchRecorder* recorder, gint64 value, const BenchMemorySample* memory)
+{
+    if (recorder->memory != NULL && recorder->n_samples < recorder->capacity)
+        recorder->memory[recorder->n_samples] = *memory;
+
+    bench_recorder_add(recorder, value);
+}
+
+void bench_recorder_enable_memory(BenchRecorder* recorder);
+void bench_recorder_discard(BenchRecorder* recorder, guint start, guint n);
+void bench_recorder_set_unit(BenchRecorder* recorder, const gchar* unit);
+void bench_recorder_compute_stats(const BenchRecorder* recorder, BenchStats* stats);
+gdouble bench_percentile(const gint64* sorted, guint n, gdouble p);
+
+guint bench_warmup_length(const gint64* samples, guint n);
+gboolean bench_median_ci(const gint64* sorted, guint n, gdouble* low, gdouble* high);
+guint bench_count_outliers(const gint64* sorted, guint n);
+
+guint bench_histogram_index(gint64 value);
+gint64 bench_histogram_lower_bound(guint index);
+void bench_recorder_histogram(const BenchRecorder* recorder, guint64* buckets);
@@ -0,0 +1,462 @@
+#include "bench-report.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string.h>
+#include <sys/utsname.h>
+
+BenchReport*
+bench_report_new(const gchar* backend)
+{
+    BenchReport* report = g_new0(BenchReport, 1);
+
+    report->backend = g_strdup(backend);
+    report->info_keys = g_ptr_array_new_with_free_func(g_free);
+    report->info_values = g_ptr_array_new_with_free_func(g_free);
+    report->value_names = g_ptr_array_new_with_free_func(g_free);
+    report->value_units = g_ptr_array_new_with_free_func(g_free);
+    report->values = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    report->metrics = g_ptr_array_new_with_free_func((GDestroyNotify)bench_recorder_free);
+
+    return report;
+}
+
+void
+bench_report_free(BenchReport* report)
+{
+    g_ptr_array_unref(report->metrics);
+    g_array_unref(report->values);
+    g_ptr_array_unref(report->value_units);
+    g_ptr_array_unref(report->value_names);
+    g_ptr_array_unref(report->info_values);
+    g_ptr_array_unref(report->info_keys);
+    g_free(report->backend);
+    g_free(report);
+}
+
+BenchRecorder*
+bench_report_add_metric(BenchReport* report, const gchar* name, guint capacity)
+{
+    BenchRecorder* recorder = bench_recorder_new(name, capacity);
+
+    g_ptr_array_add(report->metrics, recorder);
+
+    return recorder;
+}
+
+BenchRecorder*
+bench_report_get_metric(BenchReport* report, const gchar* name)
+{
+    for (guint i = 0; i < report->metrics->len; i++)
+    {
+        BenchRecorder* recorder = (BenchRecorder*)g_ptr_array_index(report->metrics, i);
+
+        if (g_strcmp0(recorder->name, name) == 0)
+            return recorder;
+    }
+
+    return NULL;
+}
+
+void
+bench_report_set_info(BenchReport* report, const gchar* key, const gchar* value)
+{
+    for (guint i = 0; i < report->info_keys->len; i++)
+    {
+        if (g_strcmp0((const gchar*)g_ptr_array_index(report->info_keys, i), key) == 0)
+        {
+            g_free(g_ptr_array_index(report->info_values, i));
+            g_ptr_array_index(report->info_values, i) = g_strdup(value);
+            return;
+        }
+    }
+
+    g_ptr_array_add(report->info_keys, g_strdup(key));
+    g_ptr_array_add(report->info_values, g_strdup(value));
+}
+
+void
+bench_report_set_info_int(BenchReport* report, const gchar* key, gint64 value)
+{
+    gchar* str = g_strdup_printf("%" G_GINT64_FORMAT, value);
+
+    bench_report_set_info(report, key, str);
+    g_free(str);
+}
+
+void
+bench_report_set_geometry(BenchReport* report, const BenchGeometry* geometry)
+{
+    bench_report_set_info_int(report, "width", geometry->width);
+    bench_report_set_info_int(report, "height", geometry->height);
+    bench_report_set_info_int(report, "number", geometry->number);
+    bench_report_set_info(report, "format", bench_format_to_string(geometry->format));
+}
+
+/* Tags the report with the machine and time it ran at, so reports in a
+ * results store can be told apart */
+void
+bench_report_set_host(BenchReport* report)
+{
+    struct utsname uts;
+    gchar* cpuinfo = NULL;
+
+    bench_report_set_info(report, "host", g_get_host_name());
+    if (uname(&uts) == 0)
+    {
+        bench_report_set_info(report, "kernel", uts.release);
+        bench_report_set_info(report, "arch", uts.machine);
+    }
+
+    if (g_file_get_contents("/proc/cpuinfo", &cpuinfo, NULL, NULL))
+    {
+        gchar** lines = g_strsplit(cpuinfo, "\n", -1);
+
+        for (gchar** line = lines; *line != NULL; line++)
+        {
+            if (g_str_has_prefix(*line, "model name"))
+            {
+                const gchar* colon = strchr(*line, ':');
+
+                if (colon != NULL)
+                {
+                    gchar* model = g_strstrip(g_strdup(colon + 1));
+                    bench_report_set_info(report, "cpu", model);
+                    g_free(model);
+                }
+                break;
+            }
+        }
+        g_strfreev(lines);
+        g_free(cpuinfo);
+    }
+
+    GDateTime* now = g_date_time_new_now_utc();
+    gchar* date = g_date_time_format_iso8601(now);
+    bench_report_set_info(report, "date", date);
+    g_free(date);
+    g_date_time_unref(now);
+}
+
+/* Single derived numbers like a throughput that have no sample distribution */
+void
+bench_report_set_value(BenchReport* report, const gchar* name, gdouble value, const gchar* unit)
+{
+    for (guint i = 0; i < report->value_names->len; i++)
+    {
+        if (g_strcmp0((const gchar*)g_ptr_array_index(report->value_names, i), name) == 0)
+        {
+            g_array_index(report->values, gdouble, i) = value;
+            g_free(g_ptr_array_index(report->value_units, i));
+            g_ptr_array_index(report->value_units, i) = g_strdup(unit);
+            return;
+        }
+    }
+
+    g_ptr_array_add(report->value_names, g_strdup(name));
+    g_ptr_array_add(report->value_units, g_strdup(unit));
+    g_array_append_val(report->values, value);
+}
+
+/* Sets name to bytes moved per ns in GB/s, plus "<name> of Peak" once the
+ * host is calibrated */
+void
+bench_report_set_bandwidth(BenchReport* report, const gchar* name, gdouble bytes, gdouble ns)
+{
+    gdouble bandwidth = ns > 0 ? bytes / ns : 0;
+
+    bench_report_set_value(report, name, bandwidth, "GB/s");
+
+    if (report->peak > 0)
+    {
+        gchar* peak = g_strdup_printf("%s of Peak", name);
+        bench_report_set_value(report, peak, 100 * bandwidth / report->peak, "%");
+        g_free(peak);
+    }
+}
+
+static void
+print_value(const gchar* label, gdouble value, const gchar* unit)
+{
+    /* keep the time metrics in ms like the original output */
+    if (g_strcmp0(unit, "ns") == 0)
+        std::cout << label << ": " << std::fixed << std::setprecision(3) << value / 1e6 << " ms" << std::endl;
+    else
+        std::cout << label << ": " << std::fixed << std::setprecision(3) << value << " " << unit << std::endl;
+}
+
+void
+bench_report_print(BenchReport* report)
+{
+    for (guint i = 0; i < report->metrics->len; i++)
+    {
+        BenchRecorder* recorder = (BenchRecorder*)g_ptr_array_index(report->metrics, i);
+        BenchStats stats;
+
+        bench_recorder_compute_stats(recorder, &stats);
+
+        std::cout << report->backend << " " << recorder->name << " (" << stats.n << " samples)" << std::endl;
+        print_value("Mean", stats.mean, recorder->unit);
+        print_value("Standard Deviation", stats.stddev, recorder->unit);
+        print_value("Max", stats.max, recorder->unit);
+        print_value("P50", stats.p50, recorder->unit);
+        print_value("P90", stats.p90, recorder->unit);
+        print_value("P99", stats.p99, recorder->unit);
+        print_value("P99.9", stats.p999, recorder->unit);
+
+        if (recorder->dropped > 0)
+            std::cout << "Dropped: " << recorder->dropped << " samples" << std::endl;
+
+        if (recorder->memory != NULL && stats.n > 0)
+        {
+            BenchMemorySample sum = { 0, 0, 0, 0, 0, 0 };
+
+            for (guint j = 0; j < stats.n; j++)
+            {
+                const BenchMemorySample* m = &recorder->memory[j];
+
+                sum.minor_faults += m->minor_faults;
+                sum.major_faults += m->major_faults;
+                sum.rss += m->rss;
+                sum.mallocs += m->mallocs;
+                sum.frees += m->frees;
+                sum.malloc_bytes += m->malloc_bytes;
+            }
+
+            print_value("Minor Faults", (gdouble)sum.minor_faults / stats.n, "per iteration");
+            print_value("Major Faults", (gdouble)sum.major_faults / stats.n, "per iteration");
+            print_value("RSS Delta", sum.rss / 1e6 / stats.n, "MB per iteration");
+            print_value("Mallocs", (gdouble)sum.mallocs / stats.n, "per iteration");
+            print_value("Frees", (gdouble)sum.frees / stats.n, "per iteration");
+            print_value("Malloc Bytes", sum.malloc_bytes / 1e6 / stats.n, "MB per iteration");
+        }
+
+        if (recorder->adaptive)
+        {
+            std::cout << "Iterations: " << stats.n + recorder->warmup << " (" << recorder->warmup << " warmup)" << std::endl;
+            print_value("P50 CI95 Low", recorder->ci_low, recorder->unit);
+            print_value("P50 CI95 High", recorder->ci_high, recorder->unit);
+            std::cout << "Outliers: " << recorder->outliers << " samples" << std::endl;
+        }
+    }
+
+    for (guint i = 0; i < report->value_names->len; i++)
+    {
+        print_value((const gchar*)g_ptr_array_index(report->value_names, i),
+            g_array_index(report->values, gdouble, i),
+            (const gchar*)g_ptr_array_index(report->value_units, i));
+    }
+}
+
+static void
+append_json_string(GString* json, const gchar* str)
+{
+    g_string_append_c(json, '"');
+    for (const gchar* c = str; *c != '\0'; c++)
+    {
+        switch (*c)
+        {
+        case '"':
+            g_string_append(json, "\\\"");
+            break;
+        case '\\':
+            g_string_append(json, "\\\\");
+            break;
+        case '\n':
+            g_string_append(json, "\\n");
+            break;
+        default:
+            if ((guchar)*c < 0x20)
+                g_string_append_printf(json, "\\u%04x", *c);
+            else
+                g_string_append_c(json, *c);
+            break;
+        }
+    }
+    g_string_append_c(json, '"');
+}
+
+static void
+append_json_double(GString* json, const gchar* key, gdouble value)
+{
+    gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+    g_string_append_printf(json, "\"%s\": %s", key, g_ascii_dtostr(buf, sizeof(buf), value));
+}
+
+static void
+append_json_metric(GString* json, BenchRecorder* recorder)
+{
+    BenchStats stats;
+    guint64* buckets = g_new(guint64, BENCH_HISTOGRAM_BUCKETS);
+
+    bench_recorder_compute_stats(recorder, &stats);
+    bench_recorder_histogram(recorder, buckets);
+
+    g_string_append(json, "    {\n      \"name\": ");
+    append_json_string(json, recorder->name);
+    g_string_append(json, ",\n      \"unit\": ");
+    append_json_string(json, recorder->unit);
+    g_string_append_printf(json, ",\n      \"n\": %u,\n      \"dropped\": %u,\n      ", stats.n, recorder->dropped);
+    append_json_double(json, "mean", stats.mean);
+    g_string_append(json, ",\n      ");
+    append_json_double(json, "stddev", stats.stddev);
+    g_string_append_printf(json, ",\n      \"min\": %" G_GINT64_FORMAT ",\n      \"max\": %" G_GINT64_FORMAT ",\n      ", stats.min, stats.max);
+    append_json_double(json, "p50", stats.p50);
+    g_string_append(json, ",\n      ");
+    append_json_double(json, "p90", stats.p90);
+    g_string_append(json, ",\n      ");
+    append_json_double(json, "p99", stats.p99);
+    g_string_append(json, ",\n      ");
+    append_json_double(json, "p99.9", stats.p999);
+
+    if (recorder->adaptive)
+    {
+        g_string_append_printf(json, ",\n      \"iterations\": %u,\n      \"warmup\": %u,\n      \"outliers\": %u,\n      ",
+            stats.n + recorder->warmup, recorder->warmup, recorder->outliers);
+        append_json_double(json, "p50_ci95_low", recorder->ci_low);
+        g_string_append(json, ",\n      ");
+        append_json_double(json, "p50_ci95_high", recorder->ci_high);
+    }
+
+    /* only the populated buckets, [lower, upper) */
+    g_string_append(json, ",\n      \"histogram\": [");
+    gboolean first = TRUE;
+    for (guint i = 0; i < BENCH_HISTOGRAM_BUCKETS; i++)
+    {
+        if (buckets[i] == 0)
+            continue;
+
+        g_string_append_printf(json, "%s\n        {\"lower\": %" G_GINT64_FORMAT ", \"upper\": %" G_GINT64_FORMAT ", \"count\": %" G_GUINT64_FORMAT "}",
+            first ? "" : ",", bench_histogram_lower_bound(i), bench_histogram_lower_bound(i + 1), buckets[i]);
+        first = FALSE;
+    }
+    g_string_append(json, first ? "]" : "\n      ]");
+
+    g_string_append(json, ",\n      \"samples\": [");
+    for (guint i = 0; i < recorder->n_samples; i++)
+    {
+        g_string_append_printf(json, "%s%" G_GINT64_FORMAT, i == 0 ? "" : ", ", recorder->samples[i]);
+    }
+    g_string_append(json, "]");
+
+    /* one entry per sample, in the same order */
+    if (recorder->memory != NULL)
+    {
+        const gchar* names[] = { "minor_faults", "major_faults", "rss_delta", "mallocs", "frees", "malloc_bytes" };
+
+        g_string_append(json, ",\n      \"memory\": {");
+        for (guint f = 0; f < G_N_ELEMENTS(names); f++)
+        {
+            g_string_append_printf(json, "%s\n        \"%s\": [", f == 0 ? "" : ",", names[f]);
+            for (guint i = 0; i < recorder->n_samples; i++)
+            {
+                const BenchMemorySample* m = &recorder->memory[i];
+                gint64 fields[] = { m->minor_faults, m->major_faults, m->rss, m->mallocs, m->frees, m->malloc_bytes };
+
+                g_string_append_printf(json, "%s%" G_GINT64_FORMAT, i == 0 ? "" : ", ", fields[f]);
+            }
+            g_string_append(json, "]");
+        }
+        g_string_append(json, "\n      }");
+    }
+    g_string_append(json, "\n    }");
+
+    g_free(buckets);
+}
+
+gchar*
+bench_report_to_json(BenchReport* report)
+{
+    GString* json = g_string_new("{\n  \"backend\": ");
+
+    append_json_string(json, report->backend);
+
+    g_string_append(json, ",\n  \"info\": {");
+    for (guint i = 0; i < report->info_keys->len; i++)
+    {
+        g_string_append(json, i == 0 ? "\n    " : ",\n    ");
+        append_json_string(json, (const gchar*)g_ptr_array_index(report->info_keys, i));
+        g_string_append(json, ": ");
+        append_json_string(json, (const gchar*)g_ptr_array_index(report->info_values, i));
+    }
+    g_string_append(json, report->info_keys->len > 0 ? "\n  }" : "}");
+
+    g_string_append(json, ",\n  \"values\": [");
+    for (guint i = 0; i < report->value_names->len; i++)
+    {
+        g_string_append(json, i == 0 ? "\n    {\"name\": " : ",\n    {\"name\": ");
+        append_json_string(json, (const gchar*)g_ptr_array_index(report->value_names, i));
+        g_string_append(json, ", ");
+        append_json_double(json, "value", g_array_index(report->values, gdouble, i));
+        g_string_append(json, ", \"unit\": ");
+        append_json_string(json, (const gchar*)g_ptr_array_index(report->value_units, i));
+        g_string_append_c(json, '}');
+    }
+    g_string_append(json, report->value_names->len > 0 ? "\n  ]" : "]");
+
+    g_string_append(json, ",\n  \"metrics\": [");
+    for (guint i = 0; i < report->metrics->len; i++)
+    {
+        g_string_append(json, i == 0 ? "\n" : ",\n");
+        append_json_metric(json, (BenchRecorder*)g_ptr_array_index(report->metrics, i));
+    }
+    g_string_append(json, report->metrics->len > 0 ? "\n  ]\n}\n" : "]\n}\n");
+
+    return g_string_free(json, FALSE);
+}
+
+gboolean
+bench_report_write_json(BenchReport* report, const gchar* path, GError** error)
+{
+    gchar* json = bench_report_to_json(report);
+    gboolean ret = g_file_set_contents(path, json, -1, error);
+
+    g_free(json);
+
+    return ret;
+}
+
+/* One row per raw sample so the file can be loaded into any dataframe as is */
+gboolean
+bench_report_write_csv(BenchReport* report, const gchar* path, GError** error)
+{
+    GString* csv = g_string_new("backend,metric,unit,iteration,value");
+    gboolean memory = FALSE;
+
+    /* the memory columns only exist if any metric has them */
+    for (guint i = 0; i < report->metrics->len; i++)
+        memory |= ((BenchRecorder*)g_ptr_array_index(report->metrics, i))->memory != NULL;
+    g_string_append(csv, memory ? ",minor_faults,major_faults,rss_delta,mallocs,frees,malloc_bytes\n" : "\n");
+
+    for (guint i = 0; i < report->metrics->len; i++)
+    {
+        BenchRecorder* recorder = (BenchRecorder*)g_ptr_array_index(report->metrics, i);
+
+        for (guint j = 0; j < recorder->n_samples; j++)
+        {
+            g_string_append_printf(csv, "%s,%s,%s,%u,%" G_GINT64_FORMAT,
+                report->backend, recorder->name, recorder->unit, j, recorder->samples[j]);
+
+            if (recorder->memory != NULL)
+            {
+                const BenchMemorySample* m = &recorder->memory[j];
+
+                g_string_append_printf(csv, ",%" G_GINT64_FORMAT ",%" G_GINT64_FORMAT ",%" G_GINT64_FORMAT
+                    ",%" G_GINT64_FORMAT ",%" G_GINT64_FORMAT ",%" G_GINT64_FORMAT,
+                    m->minor_faults, m->major_faults, m->rss, m->mallocs, m->frees, m->malloc_bytes);
+            }
+            else if (memory)
+            {
+                g_string_append(csv, ",,,,,,");
+            }
+            g_string_append_c(csv, '\n');
+        }
+    }
+
+    gboolean ret = g_file_set_contents(path, csv->str, csv->len, error);
+
+    g_string_free(csv, TRUE);
+
+    return ret;
+}
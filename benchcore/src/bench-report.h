@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glib.h>
+
+#include "bench-geometry.h"
+#include "bench-recorder.h"
+
+typedef struct _BenchReport BenchReport;
+
+/* All metrics of one benchmark run plus free form info about the setup */
+struct _BenchReport
+{
+    gchar* backend;
+
+    GPtrArray* info_keys;
+    GPtrArray* info_values;
+
+    GPtrArray* value_names;
+    GPtrArray* value_units;
+    GArray* values;
+
+    GPtrArray* metrics;
+
+    /* calibrated memory bandwidth in GB/s, 0 if not calibrated */
+    gdouble peak;
+};
+
+BenchReport* bench_report_new(const gchar* backend);
+void bench_report_free(BenchReport* report);
+
+BenchRecorder* bench_report_add_metric(BenchReport* report, const gchar* name, guint capacity);
+BenchRecorder* bench_report_get_metric(BenchReport* report, const gchar* name);
+
+void bench_report_set_info(BenchReport* report, const gchar* key, const gchar* value);
+void bench_report_set_info_int(BenchReport* report, const gchar* key, gint64 value);
+void bench_report_set_geometry(BenchReport* report, const BenchGeometry* geometry);
+void bench_report_set_host(BenchReport* report);
+void bench_report_set_value(BenchReport* report, const gchar* name, gdouble value, const gchar* unit);
+void bench_report_set_bandwidth(BenchReport* report, const gchar* name, gdouble bytes, gdouble ns);
+
+void bench_report_print(BenchReport* report);
+gchar* bench_report_to_json(BenchReport* report);
+gboolean bench_report_write_json(BenchReport* report, const gchar* path, GError** error);
+gboolean bench_report_write_csv(BenchReport* report, const gchar* path, GError** error);
@@ -0,0 +1,472 @@
+#include "bench-run.h"
+
+#include <algorithm>
+#include <iostream>
+#include <errno.h>
+#include <string.h>
+
+void
+bench_config_init(BenchConfig* config, guint width, guint height, guint number, BenchFormat format)
+{
+    memset(config, 0, sizeof(BenchConfig));
+
+    /* 0 is a value that is rejected, -1 is not given */
+    config->iterations = -1;
+    config->geometry.width = width;
+    config->geometry.height = height;
+    config->geometry.number = number;
+    config->geometry.format = format;
+    config->geometries = g_array_new(FALSE, FALSE, sizeof(BenchGeometry));
+}
+
+void
+bench_config_clear(BenchConfig* config)
+{
+    g_free(config->json_path);
+    g_free(config->csv_path);
+    g_free(config->config_path);
+    g_free(config->baseline_path);
+    g_free(config->store_path);
+    g_free(config->calibration_path);
+    if (config->baseline != NULL)
+        bench_baseline_free(config->baseline);
+    g_strfreev(config->sizes);
+    g_strfreev(config->formats);
+    g_strfreev(config->numbers);
+    g_array_unref(config->geometries);
+    if (config->perf != NULL)
+        bench_perf_free(config->perf);
+    memset(config, 0, sizeof(BenchConfig));
+}
+
+GOptionGroup*
+bench_config_get_option_group(BenchConfig* config)
+{
+    const GOptionEntry entries[] = {
+        { "iterations", 'n', 0, G_OPTION_ARG_INT, &config->iterations, "Number of measured iterations, the upper bound with --adaptive (default 3600)", "N" },
+        { "json", 0, 0, G_OPTION_ARG_FILENAME, &config->json_path, "Write the report as JSON to FILE", "FILE" },
+        { "csv", 0, 0, G_OPTION_ARG_FILENAME, &config->csv_path, "Write the raw samples as CSV to FILE", "FILE" },
+        { "store", 0, 0, G_OPTION_ARG_FILENAME, &config->store_path, "Also keep the JSON report in the results store DIR, see bench-compare", "DIR" },
+        { "config", 'c', 0, G_OPTION_ARG_FILENAME, &config->config_path, "Read the [bench] group of the key file FILE", "FILE" },
+        { "baseline", 0, 0, G_OPTION_ARG_FILENAME, &config->baseline_path, "Report the run time of the best native kernel from FILE as percentage", "FILE" },
+        { "adaptive", 0, 0, G_OPTION_ARG_NONE, &config->adaptive, "Drop the warmup and stop once the 95% confidence interval of the median is narrow enough", NULL },
+        { "ci-target", 0, 0, G_OPTION_ARG_DOUBLE, &config->ci_target, "Half width of the confidence interval to stop at, relative to the median (default 1)", "PERCENT" },
+        { "min-iterations", 0, 0, G_OPTION_ARG_INT, &config->min_iterations, "Steady state samples before an adaptive run may stop (default 20)", "N" },
+        { "max-time", 0, 0, G_OPTION_ARG_DOUBLE, &config->max_time, "Stop every run after SECONDS, adaptive or not", "SECONDS" },
+        { "memory", 0, 0, G_OPTION_ARG_NONE, &config->memory, "Record page faults, RSS and malloc calls of every iteration", NULL },
+        { "calibrate", 0, 0, G_OPTION_ARG_NONE, &config->calibrate, "Measure the memory bandwidth of the host before the benchmarks", NULL },
+        { "calibration", 0, 0, G_OPTION_ARG_FILENAME, &config->calibration_path, "Read the calibration from FILE, calibrate and write it there if it does not exist", "FILE" },
+        { "size", 0, 0, G_OPTION_ARG_STRING_ARRAY, &config->sizes, "Frame size, repeat or separate with commas to sweep", "WxH" },
+        { "format", 0, 0, G_OPTION_ARG_STRING_ARRAY, &config->formats, "Pixel format, repeat or separate with commas to sweep", "GRAY8|GRAY16|RGBA|FLOAT32" },
+        { "number", 0, 0, G_OPTION_ARG_STRING_ARRAY, &config->numbers, "Frames per batch, repeat or separate with commas to sweep", "N" },
+        { NULL }
+    };
+
+    GOptionGroup* group = g_option_group_new("bench", "Benchmark options:", "Show benchmark options", NULL, NULL);
+    g_option_group_add_entries(group, entries);
+
+    return group;
+}
+
+/* Fills in everything the command line left unset from the key file */
+static gboolean
+load_key_file(BenchConfig* config, GError** error)
+{
+    GKeyFile* key_file = g_key_file_new();
+    const gchar* group = "bench";
+
+    if (!g_key_file_load_from_file(key_file, config->config_path, G_KEY_FILE_NONE, error))
+    {
+        g_key_file_free(key_file);
+        return FALSE;
+    }
+
+    if (config->iterations == -1 && g_key_file_has_key(key_file, group, "iterations", NULL))
+        config->iterations = g_key_file_get_integer(key_file, group, "iterations", NULL);
+    if (config->json_path == NULL)
+        config->json_path = g_key_file_get_string(key_file, group, "json", NULL);
+    if (config->csv_path == NULL)
+        config->csv_path = g_key_file_get_string(key_file, group, "csv", NULL);
+    if (config->baseline_path == NULL)
+        config->baseline_path = g_key_file_get_string(key_file, group, "baseline", NULL);
+    if (config->store_path == NULL)
+        config->store_path = g_key_file_get_string(key_file, group, "store", NULL);
+    if (config->calibration_path == NULL)
+        config->calibration_path = g_key_file_get_string(key_file, group, "calibration", NULL);
+    if (!config->calibrate)
+        config->calibrate = g_key_file_get_boolean(key_file, group, "calibrate", NULL);
+    if (!config->adaptive)
+        config->adaptive = g_key_file_get_boolean(key_file, group, "adaptive", NULL);
+    if (!config->memory)
+        config->memory = g_key_file_get_boolean(key_file, group, "memory", NULL);
+    if (config->ci_target == 0 && g_key_file_has_key(key_file, group, "ci-target", NULL))
+        config->ci_target = g_key_file_get_double(key_file, group, "ci-target", NULL);
+    if (config->min_iterations == 0 && g_key_file_has_key(key_file, group, "min-iterations", NULL))
+        config->min_iterations = g_key_file_get_integer(key_file, group, "min-iterations", NULL);
+    if (config->max_time == 0 && g_key_file_has_key(key_file, group, "max-time", NULL))
+        config->max_time = g_key_file_get_double(key_file, group, "max-time", NULL);
+    if (config->sizes == NULL)
+        config->sizes = g_key_file_get_string_list(key_file, group, "sizes", NULL, NULL);
+    if (config->formats == NULL)
+        config->formats = g_key_file_get_string_list(key_file, group, "formats", NULL, NULL);
+    if (config->numbers == NULL)
+        config->numbers = g_key_file_get_string_list(key_file, group, "numbers", NULL, NULL);
+
+    g_key_file_free(key_file);
+
+    return TRUE;
+}
+
+/* Splits every entry at commas, so "--size 512x512,1024x1024" and repeating
+ * the option are the same */
+static gchar**
+split_values(gchar** values)
+{
+    GPtrArray* array = g_ptr_array_new();
+
+    for (gchar** value = values; value != NULL && *value != NULL; value++)
+    {
+        gchar** parts = g_strsplit(*value, ",", -1);
+
+        for (gchar** part = parts; *part != NULL; part++)
+        {
+            g_strstrip(*part);
+            if (**part != '\0')
+                g_ptr_array_add(array, g_strdup(*part));
+        }
+        g_strfreev(parts);
+    }
+    g_ptr_array_add(array, NULL);
+
+    return (gchar**)g_ptr_array_free(array, FALSE);
+}
+
+static gboolean
+parse_uint(const gchar* str, guint* value)
+{
+    gchar* end = NULL;
+    guint64 v = g_ascii_strtoull(str, &end, 10);
+
+    if (end == str || *end != '\0' || v == 0 || v > G_MAXUINT)
+        return FALSE;
+
+    *value = (guint)v;
+
+    return TRUE;
+}
+
+/* Builds the cartesian product of sizes, formats and numbers */
+static gboolean
+build_geometries(BenchConfig* config, GError** error)
+{
+    gchar** sizes = split_values(config->sizes);
+    gchar** formats = split_values(config->formats);
+    gchar** numbers = split_values(config->numbers);
+    guint n_sizes = MAX(g_strv_length(sizes), 1);
+    guint n_formats = MAX(g_strv_length(formats), 1);
+    guint n_numbers = MAX(g_strv_length(numbers), 1);
+    gboolean ret = TRUE;
+
+    for (guint s = 0; s < n_sizes && ret; s++)
+    {
+        for (guint f = 0; f < n_formats && ret; f++)
+        {
+            for (guint n = 0; n < n_numbers && ret; n++)
+            {
+                BenchGeometry geometry = config->geometry;
+
+                if (sizes[0] != NULL)
+                {
+                    gchar** wh = g_strsplit(sizes[s], "x", 2);
+
+                    ret = g_strv_length(wh) == 2 && parse_uint(wh[0], &geometry.width) && parse_uint(wh[1], &geometry.height);
+                    g_strfreev(wh);
+                    if (!ret)
+                        g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE, "invalid size %s", sizes[s]);
+                }
+
+                if (ret && formats[0] != NULL)
+                {
+                    ret = bench_format_from_string(formats[f], &geometry.format);
+                    if (!ret)
+                        g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE, "invalid format %s", formats[f]);
+                }
+
+                if (ret && numbers[0] != NULL)
+                {
+                    ret = parse_uint(numbers[n], &geometry.number);
+                    if (!ret)
+                        g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE, "invalid number %s", numbers[n]);
+                }
+
+                if (ret)
+                    g_array_append_val(config->geometries, geometry);
+            }
+        }
+    }
+
+    g_strfreev(numbers);
+    g_strfreev(formats);
+    g_strfreev(sizes);
+
+    return ret;
+}
+
+gboolean
+bench_config_parse(BenchConfig* config, const gchar* description,
+    const GOptionEntry* entries, gint* argc, gchar*** argv, GError** error)
+{
+    GOptionContext* context = g_option_context_new(description);
+
+    if (entries != NULL)
+        g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, bench_config_get_option_group(config));
+
+    gboolean ret = g_option_context_parse(context, argc, argv, error);
+    g_option_context_free(context);
+
+    if (ret && config->config_path != NULL)
+        ret = load_key_file(config, error);
+
+    config->iterations_set = config->iterations != -1;
+    if (ret && !config->iterations_set)
+        config->iterations = 3600;
+
+    if (ret && config->iterations <= 0)
+    {
+        g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE, "iterations must be positive");
+        ret = FALSE;
+    }
+
+    if (ret && config->ci_target == 0)
+        config->ci_target = 1;
+    if (ret && config->min_iterations == 0)
+        config->min_iterations = 20;
+
+    if (ret && (config->ci_target < 0 || config->min_iterations < 0 || config->max_time < 0))
+    {
+        g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE, "ci-target, min-iterations and max-time must be positive");
+        ret = FALSE;
+    }
+
+    if (ret && config->memory && !bench_memory_enable())
+        g_warning("malloc can not be hooked on this libc, only page faults and RSS are recorded");
+
+    if (ret)
+        ret = build_geometries(config, error);
+
+    if (ret && config->baseline_path != NULL)
+    {
+        config->baseline = bench_baseline_load(config->baseline_path, error);
+        ret = config->baseline != NULL;
+    }
+
+    return ret;
+}
+
+guint
+bench_config_get_n_geometries(const BenchConfig* config)
+{
+    return config->geometries->len;
+}
+
+const BenchGeometry*
+bench_config_get_geometry(const BenchConfig* config, guint index)
+{
+    return &g_array_index(config->geometries, BenchGeometry, index);
+}
+
+/* Metric names carry the geometry only in a sweep, so single runs keep the
+ * plain names */
+gchar*
+bench_config_get_metric_name(const BenchConfig* config, const gchar* name, const BenchGeometry* geometry)
+{
+    if (config->geometries->len <= 1)
+        return g_strdup(name);
+
+    gchar* label = bench_geometry_to_string(geometry);
+    gchar* metric = g_strdup_printf("%s %s", name, label);
+    g_free(label);
+
+    return metric;
+}
+
+/* Runs before the benchmarks, so every bandwidth can be reported relative to
+ * what the host can do. A saved calibration is reused unless --calibrate
+ * asks for a fresh one. */
+void
+bench_calibrate(BenchConfig* config, BenchReport* report)
+{
+    GError* error = NULL;
+    gboolean calibrated = FALSE;
+
+    if (!config->calibrate && config->calibration_path != NULL &&
+        g_file_test(config->calibration_path, G_FILE_TEST_EXISTS))
+    {
+        calibrated = bench_calibration_load(&config->calibration, config->calibration_path, &error);
+        if (!calibrated)
+        {
+            g_warning("could not read calibration: %s", error->message);
+            g_clear_error(&error);
+        }
+    }
+
+    if (!calibrated && (config->calibrate || config->calibration_path != NULL))
+    {
+        bench_calibration_run(&config->calibration);
+        calibrated = TRUE;
+
+        if (config->calibration_path != NULL &&
+            !bench_calibration_save(&config->calibration, config->calibration_path, &error))
+        {
+            g_warning("could not write calibration: %s", error->message);
+            g_clear_error(&error);
+        }
+    }
+
+    if (calibrated)
+        bench_calibration_report(&config->calibration, report);
+}
+
+/* Drops the warmup of the samples from start on and checks whether the
+ * interval of the median of the rest is within the target */
+static gboolean
+run_converged(const BenchConfig* config, BenchRecorder* recorder, guint start, gboolean finish)
+{
+    gint64* samples = recorder->samples + start;
+    guint n = recorder->n_samples - start;
+    guint warmup = bench_warmup_length(samples, n);
+    guint m = n - warmup;
+    gdouble low = 0, high = 0;
+    gboolean converged = FALSE;
+
+    gint64* sorted = g_new(gint64, MAX(m, 1));
+    memcpy(sorted, samples + warmup, sizeof(gint64) * m);
+    std::sort(sorted, sorted + m);
+
+    if (bench_median_ci(sorted, m, &low, &high) && m >= (guint)config->min_iterations)
+    {
+        gdouble median = bench_percentile(sorted, m, 0.5);
+
+        converged = (high - low) / 2 <= config->ci_target / 100 * median;
+    }
+
+    if (finish)
+    {
+        bench_recorder_discard(recorder, start, warmup);
+        recorder->adaptive = TRUE;
+        recorder->warmup += warmup;
+        recorder->outliers = bench_count_outliers(sorted, m);
+        recorder->ci_low = low;
+        recorder->ci_high = high;
+    }
+
+    g_free(sorted);
+
+    return converged;
+}
+
+/* Runs up to config->iterations iterations, at most max_time seconds. An
+ * adaptive run checks for convergence every 1/16th of the samples so far and
+ * stops as soon as the median is known well enough */
+void
+bench_run(const BenchConfig* config, BenchRecorder* recorder, BenchTestFunc func, gpointer user_data)
+{
+    guint start = recorder->n_samples;
+    gint64 deadline = config->max_time > 0 ? bench_now_ns() + (gint64)(config->max_time * 1e9) : G_MAXINT64;
+    guint next_check = MAX(config->min_iterations, 1);
+
+    if (config->memory)
+        bench_recorder_enable_memory(recorder);
+
+    for (gint i = 0; i < config->iterations; i++)
+    {
+        BenchMemorySample before, after, delta;
+
+        /* the counters are read outside of the memory samples, reading them
+         * allocates */
+        if (config->perf != NULL)
+            bench_perf_begin(config->perf);
+        if (config->memory)
+            bench_memory_sample(&before);
+
+        gint64 value = func(user_data);
+
+        if (config->memory)
+            bench_memory_sample(&after);
+        if (config->perf != NULL)
+            bench_perf_end(config->perf);
+
+        if (config->memory)
+        {
+            bench_memory_delta(&before, &after, &delta);
+            bench_recorder_add_memory(recorder, value, &delta);
+        }
+        else
+        {
+            bench_recorder_add(recorder, value);
+        }
+
+        if (bench_now_ns() >= deadline)
+            break;
+
+        guint n = recorder->n_samples - start;
+        if (!config->adaptive || n < next_check)
+            continue;
+
+        next_check = n + MAX(n / 16, 1);
+        if (run_converged(config, recorder, start, FALSE))
+            break;
+    }
+
+    if (config->adaptive && recorder->n_samples > start)
+        run_converged(config, recorder, start, TRUE);
+}
+
+/* Reports in a store are named <backend>-<UTC time>-<host>.json, so the
+ * newest one of a backend sorts last */
+static gboolean
+store_report(const BenchConfig* config, BenchReport* report, GError** error)
+{
+    if (g_mkdir_with_parents(config->store_path, 0755) != 0)
+    {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "could not create %s: %s",
+            config->store_path, g_strerror(errno));
+        return FALSE;
+    }
+
+    GDateTime* now = g_date_time_new_now_utc();
+    gchar* stamp = g_date_time_format(now, "%Y%m%dT%H%M%S");
+    gchar* name = g_strdup_printf("%s-%s-%s.json", report->backend, stamp, g_get_host_name());
+    gchar* path = g_build_filename(config->store_path, name, NULL);
+
+    gboolean ret = bench_report_write_json(report, path, error);
+
+    g_free(path);
+    g_free(name);
+    g_free(stamp);
+    g_date_time_unref(now);
+
+    return ret;
+}
+
+gboolean
+bench_finish(const BenchConfig* config, BenchReport* report, GError** error)
+{
+    if (config->memory)
+        bench_report_set_value(report, "Peak RSS", bench_memory_peak_rss() / 1e6, "MB");
+
+    bench_report_print(report);
+    bench_report_set_host(report);
+
+    if (config->json_path != NULL && !bench_report_write_json(report, config->json_path, error))
+        return FALSE;
+
+    if (config->store_path != NULL && !store_report(config, report, error))
+        return FALSE;
+
+    if (config->csv_path != NULL && !bench_report_write_csv(report, config->csv_path, error))
+        return FALSE;
+
+    return TRUE;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glib.h>
+
+#include "bench-baseline.h"
+#include "bench-calibrate.h"
+#include "bench-geometry.h"
+#include "bench-perf.h"
+#include "bench-recorder.h"
+#include "bench-report.h"
+
+typedef struct _BenchConfig BenchConfig;
+
+/* Options shared by all harnesses, filled in by the "bench" option group and
+ * the [bench] group of an optional key file, the command line wins */
+struct _BenchConfig
+{
+    gint iterations;
+    /* given on the command line or in the key file, not the default */
+    gboolean iterations_set;
+    gchar* json_path;
+    gchar* csv_path;
+    gchar* config_path;
+    gchar* baseline_path;
+    gchar* store_path;
+
+    /* loaded from baseline_path, NULL without --baseline */
+    BenchBaseline* baseline;
+
+    /* adaptive run control, see bench_run(). iterations is the upper bound
+     * then, max_time applies to every run */
+    gboolean adaptive;
+    gdouble ci_target;
+    gint min_iterations;
+    gdouble max_time;
+
+    /* page faults, RSS and malloc counts of every iteration */
+    gboolean memory;
+
+    /* hardware counters around every iteration, set by harnesses that report
+     * them with bench_perf_report(), freed with the config */
+    BenchPerf* perf;
+
+    /* see bench_calibrate() */
+    gboolean calibrate;
+    gchar* calibration_path;
+    BenchCalibration calibration;
+
+    /* every combination of these is run, see bench_config_get_geometry() */
+    gchar** sizes;
+    gchar** formats;
+    gchar** numbers;
+
+    /* the harness default, used for whatever is not given */
+    BenchGeometry geometry;
+    GArray* geometries;
+};
+
+/* One measured iteration, returns the duration of the measured region in ns */
+typedef gint64 (*BenchTestFunc)(gpointer user_data);
+
+void bench_config_init(BenchConfig* config, guint width, guint height, guint number, BenchFormat format);
+void bench_config_clear(BenchConfig* config);
+GOptionGroup* bench_config_get_option_group(BenchConfig* config);
+gboolean bench_config_parse(BenchConfig* config, const gchar* description,
+    const GOptionEntry* entries, gint* argc, gchar*** argv, GError** error);
+
+guint bench_config_get_n_geometries(const BenchConfig* config);
+const BenchGeometry* bench_config_get_geometry(const BenchConfig* config, guint index);
+gchar* bench_config_get_metric_name(const BenchConfig* config, const gchar* name, const BenchGeometry* geometry);
+
+void bench_calibrate(BenchConfig* config, BenchReport* report);
+void bench_run(const BenchConfig* config, BenchRecorder* recorder, BenchTestFunc func, gpointer user_data);
+gboolean bench_finish(const BenchConfig* config, BenchReport* report, GError** error);
@@ -0,0 +1,161 @@
+#include "bench-source.h"
+#include "bench-recorder.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define PAGE 4096
+
+BenchSource*
+bench_source_new(const gchar* path, guint readahead, GError** error)
+{
+    struct stat st;
+    gint fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "could not open %s: %s", path,
+            g_strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+    if (st.st_size == 0)
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is empty", path);
+        close(fd);
+        return NULL;
+    }
+
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "could not map %s: %s", path,
+            g_strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    BenchSource* source = g_new0(BenchSource, 1);
+
+    source->data = (const guint8*)data;
+    source->size = st.st_size;
+    source->fd = fd;
+    source->readahead = readahead;
+
+    /* larger readahead windows, and pages behind the reader go first */
+    if (madvise((gpointer)source->data, source->size, MADV_SEQUENTIAL) != 0)
+        g_warning("madvise(MADV_SEQUENTIAL) failed: %s", g_strerror(errno));
+
+    return source;
+}
+
+void
+bench_source_free(BenchSource* source)
+{
+    munmap((gpointer)source->data, source->size);
+    close(source->fd);
+    g_free(source);
+}
+
+gboolean
+bench_source_set_frame_size(BenchSource* source, gsize frame_size, GError** error)
+{
+    g_return_val_if_fail(frame_size > 0, FALSE);
+
+    if (source->size < frame_size)
+    {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+            "%" G_GSIZE_FORMAT " bytes do not hold a frame of %" G_GSIZE_FORMAT " bytes", source->size, frame_size);
+        return FALSE;
+    }
+
+    source->frame_size = frame_size;
+    source->n_frames = source->size / frame_size;
+    source->next = 0;
+    source->advised = 0;
+
+    return TRUE;
+}
+
+/* WILLNEED only starts the reads, the pages are in the cache by the time the
+ * frames are handed out if the disk keeps up */
+static void
+advise(BenchSource* source, guint first, guint end)
+{
+    gsize start = (gsize)first * source->frame_size / PAGE * PAGE;
+    gsize stop = (gsize)end * source->frame_size;
+
+    if (madvise((gpointer)(source->data + start), stop - start, MADV_WILLNEED) != 0)
+        g_warning("madvise(MADV_WILLNEED) failed: %s", g_strerror(errno));
+}
+
+const guint8*
+bench_source_next(BenchSource* source, guint n)
+{
+    g_return_val_if_fail(n > 0 && n <= source->n_frames, NULL);
+
+    if (source->next + n > source->n_frames)
+    {
+        source->next = 0;
+        source->advised = 0;
+    }
+
+    guint first = source->next;
+    guint end = MIN(first + n + source->readahead, source->n_frames);
+
+    if (end > source->advised)
+    {
+        advise(source, MAX(first, source->advised), end);
+        source->advised = end;
+    }
+
+    source->next += n;
+
+    return source->data + (gsize)first * source->frame_size;
+}
+
+void
+bench_source_evict(BenchSource* source)
+{
+    /* our own mapping holds on to the pages, the cache can only drop them
+     * once nothing maps them */
+    madvise((gpointer)source->data, source->size, MADV_DONTNEED);
+
+    gint ret = posix_fadvise(source->fd, 0, 0, POSIX_FADV_DONTNEED);
+    if (ret != 0)
+        g_warning("posix_fadvise(POSIX_FADV_DONTNEED) failed: %s", g_strerror(ret));
+
+    source->next = 0;
+    source->advised = 0;
+}
+
+gint64
+bench_source_read_cold(BenchSource* source)
+{
+    g_return_val_if_fail(source->n_frames > 0, 0);
+
+    bench_source_evict(source);
+
+    gint64 start = bench_now_ns();
+    guint8 sum = 0;
+
+    for (guint i = 0; i < source->n_frames; i++)
+    {
+        const volatile guint8* frame = bench_source_next(source, 1);
+
+        for (gsize offset = 0; offset < source->frame_size; offset += PAGE)
+            sum += frame[offset];
+    }
+
+    gint64 elapsed = bench_now_ns() - start;
+
+    (void)sum;
+    source->next = 0;
+    source->advised = 0;
+
+    return elapsed;
+}
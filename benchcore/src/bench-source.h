@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glib.h>
+
+typedef struct _BenchSource BenchSource;
+
+/* A raw frame stack on disk, mapped and handed out frame by frame without a
+ * copy. The kernel is asked to read ahead a number of frames past the ones
+ * handed out, so a sequential reader finds them in the page cache. Meant for
+ * a single reader thread */
+struct _BenchSource
+{
+    const guint8* data;
+    gsize size;
+    gint fd;
+
+    /* whole frames in the file, trailing bytes are left out */
+    gsize frame_size;
+    guint n_frames;
+    guint readahead;
+
+    /* next frame to hand out, and where the readahead advice ends */
+    guint next;
+    guint advised;
+};
+
+/* Maps the file read only, so frames are only ever backed by the page cache
+ * and whoever wants to write one has to copy it first */
+BenchSource* bench_source_new(const gchar* path, guint readahead, GError** error);
+void bench_source_free(BenchSource* source);
+
+/* Fails if the file does not hold a single frame of frame_size, starts over
+ * at the first frame */
+gboolean bench_source_set_frame_size(BenchSource* source, gsize frame_size, GError** error);
+
+/* n frames that follow each other in the file, the next ones or the first n
+ * once fewer than n are left */
+const guint8* bench_source_next(BenchSource* source, guint n);
+
+/* Drops the file from the page cache, the next reads go to the disk */
+void bench_source_evict(BenchSource* source);
+
+/* Evicts the file and reads it once front to back with the readahead of
+ * bench_source_next(), returns the time it took */
+gint64 bench_source_read_cold(BenchSource* source);
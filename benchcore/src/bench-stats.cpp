@@ -0,0 +1,102 @@
+#include "bench-stats.h"
+#include "bench-recorder.h"
+
+#include <algorithm>
+#include <cmath>
+
+typedef struct _Ranked
+{
+    gint64 value;
+    gboolean in_a;
+} Ranked;
+
+gdouble
+bench_mann_whitney(const gint64* a, guint n_a, const gint64* b, guint n_b)
+{
+    guint n = n_a + n_b;
+
+    if (n_a == 0 || n_b == 0)
+        return 1;
+
+    Ranked* all = g_new(Ranked, n);
+    for (guint i = 0; i < n_a; i++)
+        all[i] = { a[i], TRUE };
+    for (guint i = 0; i < n_b; i++)
+        all[n_a + i] = { b[i], FALSE };
+
+    std::sort(all, all + n, [](const Ranked& x, const Ranked& y) { return x.value < y.value; });
+
+    /* ties share the mean of their ranks */
+    gdouble rank_sum = 0, ties = 0;
+    for (guint i = 0; i < n;)
+    {
+        guint j = i;
+        while (j < n && all[j].value == all[i].value)
+            j++;
+
+        gdouble rank = (i + 1 + j) / 2.0;
+        gdouble t = j - i;
+
+        for (guint k = i; k < j; k++)
+        {
+            if (all[k].in_a)
+                rank_sum += rank;
+        }
+        ties += t * t * t - t;
+        i = j;
+    }
+
+    g_free(all);
+
+    gdouble u = rank_sum - n_a * (n_a + 1) / 2.0;
+    gdouble mean = (gdouble)n_a * n_b / 2;
+    gdouble var = (gdouble)n_a * n_b / 12 * ((n + 1) - ties / ((gdouble)n * (n - 1)));
+
+    if (var <= 0)
+        return 1;
+
+    /* a small U means a ranks low, i.e. b is larger */
+    gdouble z = (u - mean + 0.5) / std::sqrt(var);
+
+    return 0.5 * std::erfc(-z / std::sqrt(2.0));
+}
+
+static gdouble
+resample_median(const gint64* samples, guint n, gint64* scratch, GRand* rand)
+{
+    for (guint i = 0; i < n; i++)
+        scratch[i] = samples[g_rand_int_range(rand, 0, n)];
+
+    std::nth_element(scratch, scratch + n / 2, scratch + n);
+
+    return scratch[n / 2];
+}
+
+void
+bench_bootstrap_median_ratio(const gint64* a, guint n_a, const gint64* b, guint n_b,
+    guint resamples, gdouble confidence, GRand* rand, gdouble* low, gdouble* high)
+{
+    *low = *high = 0;
+
+    if (n_a == 0 || n_b == 0 || resamples == 0)
+        return;
+
+    gint64* scratch = g_new(gint64, MAX(n_a, n_b));
+    gint64* ratios = g_new(gint64, resamples);
+
+    /* in parts per million, so bench_percentile() can sort them */
+    for (guint r = 0; r < resamples; r++)
+    {
+        gdouble median_a = resample_median(a, n_a, scratch, rand);
+        gdouble median_b = resample_median(b, n_b, scratch, rand);
+
+        ratios[r] = median_a > 0 ? (gint64)(1e6 * median_b / median_a) : 0;
+    }
+
+    std::sort(ratios, ratios + resamples);
+    *low = bench_percentile(ratios, resamples, (1 - confidence) / 2) / 1e6;
+    *high = bench_percentile(ratios, resamples, (1 + confidence) / 2) / 1e6;
+
+    g_free(ratios);
+    g_free(scratch);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <glib.h>
+
+/* One sided Mann-Whitney U test of whether b tends to be larger than a,
+ * normal approximation with tie correction. Returns the p-value */
+gdouble bench_mann_whitney(const gint64* a, guint n_a, const gint64* b, guint n_b);
+
+/* Percentile bootstrap of the ratio of the medians of b and a, the interval
+ * holds the given confidence, e.g. 0.95 */
+void bench_bootstrap_median_ratio(const gint64* a, guint n_a, const gint64* b, guint n_b,
+    guint resamples, gdouble confidence, GRand* rand, gdouble* low, gdouble* high);
@@ -0,0 +1,96 @@
+#include "bench-thread.h"
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <atomic>
+
+#define MAX_HOOKS 8
+
+typedef struct _Hook
+{
+    BenchThreadFunc func;
+    gpointer user_data;
+} Hook;
+
+static GMutex lock;
+static Hook hooks[MAX_HOOKS];
+static std::atomic<guint> n_hooks;
+
+void
+bench_thread_add_start_hook(BenchThreadFunc func, gpointer user_data)
+{
+    g_mutex_lock(&lock);
+    if (n_hooks < MAX_HOOKS)
+    {
+        hooks[n_hooks].func = func;
+        hooks[n_hooks].user_data = user_data;
+        n_hooks++;
+    }
+    else
+        g_warning("too many thread start hooks");
+    g_mutex_unlock(&lock);
+}
+
+void
+bench_thread_remove_start_hook(BenchThreadFunc func, gpointer user_data)
+{
+    g_mutex_lock(&lock);
+    for (guint i = 0; i < n_hooks; i++)
+    {
+        if (hooks[i].func == func && hooks[i].user_data == user_data)
+        {
+            hooks[i] = hooks[n_hooks - 1];
+            n_hooks--;
+            break;
+        }
+    }
+    g_mutex_unlock(&lock);
+}
+
+typedef struct _Start
+{
+    void* (*func)(void*);
+    void* arg;
+} Start;
+
+static void*
+start_thread(void* data)
+{
+    Start start = *(Start*)data;
+    Hook current[MAX_HOOKS];
+    guint n;
+
+    g_free(data);
+
+    /* a hook may add or remove hooks, so they run on a copy */
+    g_mutex_lock(&lock);
+    n = n_hooks;
+    for (guint i = 0; i < n; i++)
+        current[i] = hooks[i];
+    g_mutex_unlock(&lock);
+
+    for (guint i = 0; i < n; i++)
+        current[i].func(current[i].user_data);
+
+    return start.func(start.arg);
+}
+
+extern "C" int
+pthread_create(pthread_t* thread, const pthread_attr_t* attr, void* (*func)(void*), void* arg)
+{
+    static decltype(&pthread_create) real = (decltype(&pthread_create))dlsym(RTLD_NEXT, "pthread_create");
+
+    if (n_hooks == 0)
+        return real(thread, attr, func, arg);
+
+    Start* start = g_new(Start, 1);
+
+    start->func = func;
+    start->arg = arg;
+
+    gint ret = real(thread, attr, start_thread, start);
+    if (ret != 0)
+        g_free(start);
+
+    return ret;
+}
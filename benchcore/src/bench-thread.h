@@ -0,0 +1,11 @@
+#pragma once
+
+#include <glib.h>
+
+typedef void (*BenchThreadFunc)(gpointer user_data);
+
+/* Runs func in every thread started from now on, before the thread runs any
+ * code of whoever started it. pthread_create is interposed for that, so it
+ * covers the threads of GStreamer, UFO and the OpenCL drivers alike */
+void bench_thread_add_start_hook(BenchThreadFunc func, gpointer user_data);
+void bench_thread_remove_start_hook(BenchThreadFunc func, gpointer user_data);
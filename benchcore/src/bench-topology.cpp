@@ -0,0 +1,321 @@
+#include "bench-topology.h"
+
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <sched.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* nodes a bind mask has room for */
+#define MAX_NODES 1024
+
+GArray*
+bench_cpulist_parse(const gchar* list)
+{
+    GArray* cpus = g_array_new(FALSE, FALSE, sizeof(gint));
+    gchar* copy = g_strstrip(g_strdup(list));
+    gchar** ranges = g_strsplit(copy, ",", -1);
+
+    for (gchar** range = ranges; *range != NULL && cpus != NULL; range++)
+    {
+        gchar* end = NULL;
+        gint first = (gint)g_ascii_strtoll(*range, &end, 10);
+        gint last = first;
+
+        if (**range == '\0')
+            continue;
+        if (*end == '-')
+            last = (gint)g_ascii_strtoll(end + 1, &end, 10);
+
+        if (end == *range || *end != '\0' || first < 0 || last < first)
+        {
+            g_array_unref(cpus);
+            cpus = NULL;
+            break;
+        }
+
+        for (gint cpu = first; cpu <= last; cpu++)
+            g_array_append_val(cpus, cpu);
+    }
+
+    g_strfreev(ranges);
+    g_free(copy);
+
+    return cpus;
+}
+
+gchar*
+bench_cpulist_to_string(const gint* cpus, guint n_cpus)
+{
+    GString* list = g_string_new(NULL);
+
+    for (guint i = 0; i < n_cpus; i++)
+    {
+        guint last = i;
+
+        /* runs of consecutive CPUs collapse into a range */
+        while (last + 1 < n_cpus && cpus[last + 1] == cpus[last] + 1)
+            last++;
+
+        g_string_append_printf(list, "%s%d", list->len > 0 ? "," : "", cpus[i]);
+        if (last > i)
+            g_string_append_printf(list, "-%d", cpus[last]);
+        i = last;
+    }
+
+    return g_string_free(list, FALSE);
+}
+
+/* A sysfs CPU list, empty if the file is missing */
+static GArray*
+parse_cpulist(const gchar* path)
+{
+    gchar* contents = NULL;
+    GArray* cpus = NULL;
+
+    if (g_file_get_contents(path, &contents, NULL, NULL))
+        cpus = bench_cpulist_parse(contents);
+
+    g_free(contents);
+
+    return cpus != NULL ? cpus : g_array_new(FALSE, FALSE, sizeof(gint));
+}
+
+/* The first SMT sibling of a core comes first in the pinning order */
+static gboolean
+is_primary_thread(gint cpu)
+{
+    gchar* path = g_strdup_printf("/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    GArray* siblings = parse_cpulist(path);
+    gboolean primary = siblings->len == 0 || g_array_index(siblings, gint, 0) == cpu;
+
+    g_array_unref(siblings);
+    g_free(path);
+
+    return primary;
+}
+
+static gboolean
+contains(GArray* cpus, gint cpu)
+{
+    for (guint i = 0; i < cpus->len; i++)
+    {
+        if (g_array_index(cpus, gint, i) == cpu)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* Appends the online CPUs of one node that are not placed yet */
+static void
+append_node(BenchTopology* topology, GArray* online, GArray* cpus, gint node)
+{
+    guint n_cpus = topology->n_cpus;
+
+    for (gint pass = 0; pass < 2; pass++)
+    {
+        for (guint i = 0; i < cpus->len; i++)
+        {
+            gint cpu = g_array_index(cpus, gint, i);
+
+            if (!contains(online, cpu) || is_primary_thread(cpu) != (pass == 0))
+                continue;
+
+            gboolean placed = FALSE;
+            for (guint j = 0; j < topology->n_cpus && !placed; j++)
+                placed = topology->cpus[j] == cpu;
+            if (placed)
+                continue;
+
+            topology->cpus[topology->n_cpus] = cpu;
+            topology->nodes[topology->n_cpus] = node;
+            topology->n_cpus++;
+        }
+    }
+
+    if (topology->n_cpus > n_cpus)
+        topology->n_nodes++;
+}
+
+static gint
+compare_int(gconstpointer a, gconstpointer b)
+{
+    return *(const gint*)a - *(const gint*)b;
+}
+
+BenchTopology*
+bench_topology_new()
+{
+    BenchTopology* topology = g_new0(BenchTopology, 1);
+    GArray* online = parse_cpulist("/sys/devices/system/cpu/online");
+    GArray* nodes = g_array_new(FALSE, FALSE, sizeof(gint));
+    GDir* dir = g_dir_open("/sys/devices/system/node", 0, NULL);
+
+    /* without sysfs fall back to one node with every processor */
+    if (online->len == 0)
+    {
+        for (gint cpu = 0; cpu < (gint)g_get_num_processors(); cpu++)
+            g_array_append_val(online, cpu);
+    }
+
+    topology->cpus = g_new0(gint, online->len);
+    topology->nodes = g_new0(gint, online->len);
+
+    if (dir != NULL)
+    {
+        const gchar* name;
+
+        while ((name = g_dir_read_name(dir)) != NULL)
+        {
+            if (g_str_has_prefix(name, "node") && g_ascii_isdigit(name[4]))
+            {
+                gint node = atoi(name + 4);
+                g_array_append_val(nodes, node);
+            }
+        }
+        g_dir_close(dir);
+    }
+    g_array_sort(nodes, compare_int);
+
+    for (guint i = 0; i < nodes->len; i++)
+    {
+        gint node = g_array_index(nodes, gint, i);
+        gchar* path = g_strdup_printf("/sys/devices/system/node/node%d/cpulist", node);
+        GArray* cpus = parse_cpulist(path);
+
+        append_node(topology, online, cpus, node);
+        g_array_unref(cpus);
+        g_free(path);
+    }
+
+    /* CPUs without a node, or no NUMA support at all */
+    if (topology->n_cpus < online->len)
+    {
+        guint n_nodes = topology->n_nodes;
+
+        append_node(topology, online, online, nodes->len > 0 ? g_array_index(nodes, gint, 0) : 0);
+        if (n_nodes > 0)
+            topology->n_nodes = n_nodes;
+    }
+
+    g_array_unref(nodes);
+    g_array_unref(online);
+
+    return topology;
+}
+
+void
+bench_topology_free(BenchTopology* topology)
+{
+    g_free(topology->cpus);
+    g_free(topology->nodes);
+    g_free(topology);
+}
+
+gint
+bench_topology_get_node(const BenchTopology* topology, gint cpu)
+{
+    for (guint i = 0; i < topology->n_cpus; i++)
+    {
+        if (topology->cpus[i] == cpu)
+            return topology->nodes[i];
+    }
+
+    return -1;
+}
+
+void
+bench_topology_report(const BenchTopology* topology, BenchReport* report)
+{
+    GString* description = g_string_new(NULL);
+    GArray* cpus = g_array_new(FALSE, FALSE, sizeof(gint));
+
+    /* the nodes come in order, one after another */
+    for (guint i = 0; i < topology->n_cpus; i++)
+    {
+        gint node = topology->nodes[i];
+
+        g_array_append_val(cpus, topology->cpus[i]);
+        if (i + 1 < topology->n_cpus && topology->nodes[i + 1] == node)
+            continue;
+
+        g_array_sort(cpus, compare_int);
+        gchar* list = bench_cpulist_to_string((const gint*)(gpointer)cpus->data, cpus->len);
+        g_string_append_printf(description, "%snode%d:%s", description->len > 0 ? " " : "", node, list);
+        g_free(list);
+        g_array_set_size(cpus, 0);
+    }
+
+    bench_report_set_info_int(report, "nodes", topology->n_nodes);
+    bench_report_set_info(report, "topology", description->str);
+
+    g_array_unref(cpus);
+    g_string_free(description, TRUE);
+}
+
+gboolean
+bench_pin_thread_cpus(const gint* cpus, guint n_cpus)
+{
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    for (guint i = 0; i < n_cpus; i++)
+    {
+        if (cpus[i] < 0 || cpus[i] >= CPU_SETSIZE)
+            return FALSE;
+        CPU_SET(cpus[i], &set);
+    }
+
+    /* 0 is the calling thread, not the whole process */
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+gboolean
+bench_pin_thread(gint cpu)
+{
+    return bench_pin_thread_cpus(&cpu, 1);
+}
+
+static gboolean
+node_mask(gint node, unsigned long* mask)
+{
+    if (node < 0 || node >= MAX_NODES)
+        return FALSE;
+
+    memset(mask, 0, MAX_NODES / 8);
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+
+    return TRUE;
+}
+
+gboolean
+bench_bind_thread_memory(gint node)
+{
+    unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long))];
+
+    if (!node_mask(node, mask))
+        return FALSE;
+
+    return syscall(SYS_set_mempolicy, MPOL_BIND, mask, MAX_NODES + 1) == 0;
+}
+
+gboolean
+bench_bind_memory(gpointer data, gsize size, gint node)
+{
+    unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long))];
+    gsize page = sysconf(_SC_PAGESIZE);
+    guintptr start = ((guintptr)data + page - 1) / page * page;
+    guintptr end = ((guintptr)data + size) / page * page;
+
+    if (!node_mask(node, mask))
+        return FALSE;
+
+    /* less than a page, nothing to bind */
+    if (end <= start)
+        return TRUE;
+
+    return syscall(SYS_mbind, start, end - start, MPOL_BIND, mask, MAX_NODES + 1, MPOL_MF_MOVE) == 0;
+}
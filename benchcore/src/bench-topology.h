@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glib.h>
+
+#include "bench-report.h"
+
+typedef struct _BenchTopology BenchTopology;
+
+/* Online CPUs in the order threads are pinned: node by node, and within a
+ * node one hardware thread per core before any SMT siblings, so n threads
+ * stay on as few nodes and cores as possible */
+struct _BenchTopology
+{
+    guint n_cpus;
+    gint* cpus;
+    gint* nodes;
+    guint n_nodes;
+};
+
+BenchTopology* bench_topology_new();
+void bench_topology_free(BenchTopology* topology);
+
+/* -1 for a CPU that is not online */
+gint bench_topology_get_node(const BenchTopology* topology, gint cpu);
+
+/* Records the nodes and the CPUs of each as info "topology" */
+void bench_topology_report(const BenchTopology* topology, BenchReport* report);
+
+/* A CPU list like "0-3,8-11", NULL if it does not parse */
+GArray* bench_cpulist_parse(const gchar* list);
+gchar* bench_cpulist_to_string(const gint* cpus, guint n_cpus);
+
+/* The calling thread only, other threads keep their affinity and policy.
+ * Threads it starts later inherit both */
+gboolean bench_pin_thread(gint cpu);
+gboolean bench_pin_thread_cpus(const gint* cpus, guint n_cpus);
+gboolean bench_bind_thread_memory(gint node);
+
+/* Binds the whole pages within data to node, pages that are already faulted
+ * in are moved */
+gboolean bench_bind_memory(gpointer data, gsize size, gint node);
@@ -0,0 +1,199 @@
+#include "bench-trace.h"
+
+#include <string.h>
+
+static std::atomic<guint> trace_ids(1);
+
+/* Ring of the current thread for the trace that was stamped last */
+static thread_local guint tl_trace_id = 0;
+static thread_local BenchTraceRing* tl_ring = NULL;
+
+static BenchTraceRing*
+bench_trace_ring_new(guint capacity)
+{
+    BenchTraceRing* ring = g_new0(BenchTraceRing, 1);
+
+    ring->events = g_new0(BenchTraceEvent, capacity);
+    ring->capacity = capacity;
+    ring->head.store(0);
+
+    return ring;
+}
+
+static void
+bench_trace_ring_free(BenchTraceRing* ring)
+{
+    g_free(ring->events);
+    g_free(ring);
+}
+
+BenchTrace*
+bench_trace_new(guint ring_capacity)
+{
+    BenchTrace* trace = g_new0(BenchTrace, 1);
+
+    trace->id = trace_ids.fetch_add(1);
+    trace->ring_capacity = ring_capacity;
+    trace->stages = g_ptr_array_new_with_free_func(g_free);
+    trace->metrics = g_ptr_array_new();
+    trace->rings = g_ptr_array_new_with_free_func((GDestroyNotify)bench_trace_ring_free);
+    trace->ring_threads = g_ptr_array_new();
+    g_mutex_init(&trace->lock);
+
+    return trace;
+}
+
+void
+bench_trace_free(BenchTrace* trace)
+{
+    g_mutex_clear(&trace->lock);
+    g_ptr_array_unref(trace->ring_threads);
+    g_ptr_array_unref(trace->rings);
+    /* the recorders are owned by the report */
+    g_ptr_array_unref(trace->metrics);
+    g_ptr_array_unref(trace->stages);
+    g_free(trace);
+}
+
+guint
+bench_trace_add_stage(BenchTrace* trace, const gchar* name)
+{
+    g_ptr_array_add(trace->stages, g_strdup(name));
+
+    return trace->stages->len - 1;
+}
+
+/* One metric per hop between consecutive stages plus one from the first to
+ * the last stage */
+static void
+add_metric(BenchTrace* trace, BenchReport* report, gchar* name, const gchar* suffix, guint capacity)
+{
+    if (suffix != NULL)
+    {
+        gchar* full = g_strdup_printf("%s %s", name, suffix);
+        g_free(name);
+        name = full;
+    }
+
+    g_ptr_array_add(trace->metrics, bench_report_add_metric(report, name, capacity));
+    g_free(name);
+}
+
+void
+bench_trace_add_metrics(BenchTrace* trace, BenchReport* report, const gchar* suffix, guint capacity)
+{
+    guint n = trace->stages->len;
+
+    for (guint i = 0; i + 1 < n; i++)
+    {
+        gchar* name = g_strdup_printf("trace %s->%s",
+            (const gchar*)g_ptr_array_index(trace->stages, i),
+            (const gchar*)g_ptr_array_index(trace->stages, i + 1));
+
+        add_metric(trace, report, name, suffix, capacity);
+    }
+
+    if (n > 2)
+    {
+        gchar* name = g_strdup_printf("trace %s->%s",
+            (const gchar*)g_ptr_array_index(trace->stages, 0),
+            (const gchar*)g_ptr_array_index(trace->stages, n - 1));
+
+        add_metric(trace, report, name, suffix, capacity);
+    }
+}
+
+static BenchTraceRing*
+bench_trace_get_ring(BenchTrace* trace)
+{
+    if (G_LIKELY(tl_trace_id == trace->id))
+        return tl_ring;
+
+    GThread* self = g_thread_self();
+    BenchTraceRing* ring = NULL;
+
+    g_mutex_lock(&trace->lock);
+    for (guint i = 0; i < trace->ring_threads->len; i++)
+    {
+        if (g_ptr_array_index(trace->ring_threads, i) == self)
+            ring = (BenchTraceRing*)g_ptr_array_index(trace->rings, i);
+    }
+    if (ring == NULL)
+    {
+        ring = bench_trace_ring_new(trace->ring_capacity);
+        g_ptr_array_add(trace->rings, ring);
+        g_ptr_array_add(trace->ring_threads, self);
+    }
+    g_mutex_unlock(&trace->lock);
+
+    tl_trace_id = trace->id;
+    tl_ring = ring;
+
+    return ring;
+}
+
+void
+bench_trace_stamp(BenchTrace* trace, guint stage, guint64 id)
+{
+    BenchTraceRing* ring = bench_trace_get_ring(trace);
+    guint64 head = ring->head.load(std::memory_order_relaxed);
+    BenchTraceEvent* event = &ring->events[head % ring->capacity];
+
+    event->id = id;
+    event->stage = stage;
+    event->time = bench_now_ns();
+
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+/* Match the events of frames 0..n_ids-1 over all rings, add the latencies to
+ * the metrics and empty the rings. Must only be called while no thread stamps */
+void
+bench_trace_collect(BenchTrace* trace, guint64 n_ids)
+{
+    guint n_stages = trace->stages->len;
+
+    g_return_if_fail(trace->metrics->len > 0);
+
+    gint64* times = g_new(gint64, n_stages * n_ids);
+
+    for (guint64 i = 0; i < n_stages * n_ids; i++)
+    {
+        times[i] = -1;
+    }
+
+    g_mutex_lock(&trace->lock);
+    for (guint r = 0; r < trace->rings->len; r++)
+    {
+        BenchTraceRing* ring = (BenchTraceRing*)g_ptr_array_index(trace->rings, r);
+        guint64 head = ring->head.load(std::memory_order_acquire);
+        guint64 start = head > ring->capacity ? head - ring->capacity : 0;
+
+        for (guint64 i = start; i < head; i++)
+        {
+            BenchTraceEvent* event = &ring->events[i % ring->capacity];
+
+            if (event->id < n_ids && event->stage < n_stages)
+                times[event->id * n_stages + event->stage] = event->time;
+        }
+
+        ring->head.store(0, std::memory_order_relaxed);
+    }
+    g_mutex_unlock(&trace->lock);
+
+    for (guint64 id = 0; id < n_ids; id++)
+    {
+        gint64* t = &times[id * n_stages];
+
+        for (guint s = 0; s + 1 < n_stages; s++)
+        {
+            if (t[s] >= 0 && t[s + 1] >= 0)
+                bench_recorder_add((BenchRecorder*)g_ptr_array_index(trace->metrics, s), t[s + 1] - t[s]);
+        }
+
+        if (n_stages > 2 && t[0] >= 0 && t[n_stages - 1] >= 0)
+            bench_recorder_add((BenchRecorder*)g_ptr_array_index(trace->metrics, n_stages - 1), t[n_stages - 1] - t[0]);
+    }
+
+    g_free(times);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glib.h>
+#include <atomic>
+
+#include "bench-recorder.h"
+#include "bench-report.h"
+
+typedef struct _BenchTraceEvent BenchTraceEvent;
+typedef struct _BenchTraceRing BenchTraceRing;
+typedef struct _BenchTrace BenchTrace;
+
+struct _BenchTraceEvent
+{
+    guint64 id;
+    guint stage;
+    gint64 time;
+};
+
+/* Single producer ring, only ever written by the thread that owns it. The
+ * reader only looks at it while the producers are idle, so publishing head
+ * with release semantics is all the synchronisation needed */
+struct _BenchTraceRing
+{
+    BenchTraceEvent* events;
+    guint capacity;
+    std::atomic<guint64> head;
+};
+
+/* Timestamps of frames passing a fixed sequence of stages, e.g. the pads of a
+ * pipeline. Every stamping thread gets its own ring, so stamping never locks
+ * except for the very first stamp of a thread */
+struct _BenchTrace
+{
+    guint id;
+    guint ring_capacity;
+
+    GPtrArray* stages;
+    GPtrArray* metrics;
+
+    GMutex lock;
+    GPtrArray* rings;
+    GPtrArray* ring_threads;
+};
+
+BenchTrace* bench_trace_new(guint ring_capacity);
+void bench_trace_free(BenchTrace* trace);
+
+guint bench_trace_add_stage(BenchTrace* trace, const gchar* name);
+/* Adds one metric per hop and one end to end, named "trace a->b [suffix]" */
+void bench_trace_add_metrics(BenchTrace* trace, BenchReport* report, const gchar* suffix, guint capacity);
+
+void bench_trace_stamp(BenchTrace* trace, guint stage, guint64 id);
+void bench_trace_collect(BenchTrace* trace, guint64 n_ids);
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "bench-arena.h"
+#include "bench-baseline.h"
+#include "bench-calibrate.h"
+#include "bench-geometry.h"
+#include "bench-memory.h"
+#include "bench-perf.h"
+#include "bench-recorder.h"
+#include "bench-report.h"
+#include "bench-run.h"
+#include "bench-source.h"
+#include "bench-stats.h"
+#include "bench-thread.h"
+#include "bench-topology.h"
+#include "bench-trace.h"
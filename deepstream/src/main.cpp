@@ -2,6 +2,7 @@
 #include <gst/video/video.h>
 #include <gst/app/gstappsrc.h>
 #include <gst/app/gstappsink.h>
+#include <benchcore/bench.h>
 #include <cuda_runtime_api.h>
 #include <nvbufsurface.h>
 
@@ -10,7 +11,6 @@
 #include <string.h>
 #include <stdlib.h>
 #include <chrono>
-#include <cmath>
 
 #include "values.h"
 
@@ -38,6 +38,9 @@ struct _App
     gint ms_int;
 
     GstBufferList* buffer;
+
+    BenchGeometry geometry;
+    gsize frame_size;
 };
 
 App s_app;
@@ -171,12 +174,34 @@ check_error(GError** error)
     }
 }
 
+/* nvvideoconvert only takes the packed formats, GRAY16 and FLOAT32 frames are
+ * rejected by main() */
+static gboolean
+nvbuf_format(BenchFormat format, GstVideoFormat* video, NvBufSurfaceColorFormat* color)
+{
+    switch (format)
+    {
+    case BENCH_FORMAT_GRAY8:
+        *video = GST_VIDEO_FORMAT_GRAY8;
+        *color = NVBUF_COLOR_FORMAT_GRAY8;
+        return TRUE;
+    case BENCH_FORMAT_RGBA:
+        *video = GST_VIDEO_FORMAT_RGBA;
+        *color = NVBUF_COLOR_FORMAT_RGBA;
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
 void setup()
 {
     App* app = &s_app;
     GError* error = NULL;
     GstCaps* caps;
     GstVideoInfo info;
+    GstVideoFormat format;
+    NvBufSurfaceColorFormat color;
 
     app->pipeline = gst_parse_launch("appsrc name=mysource ! nvvideoconvert flip-method=4 nvbuf-memory-type=2 ! appsink name=mysink", &error);
     check_error(&error);
@@ -187,23 +212,24 @@ void setup()
     g_assert(app->appsrc);
 
     /* set the caps on the source */
-    gst_video_info_set_format(&info, GST_VIDEO_FORMAT_RGBA, WIDTH, HEIGHT);
+    nvbuf_format(app->geometry.format, &format, &color);
+    gst_video_info_set_format(&info, format, app->geometry.width, app->geometry.height);
     caps = gst_video_info_to_caps(&info);
     GstCapsFeatures* feature = gst_caps_features_new("memory:NVMM", NULL);
     gst_caps_set_features (caps, 0, feature);
     g_object_set(app->appsrc,
                 "caps", caps,
                 "format", GST_FORMAT_TIME,
-                "max-buffers", NUMBER,
-                "max-bytes", NUMBER * WIDTH * HEIGHT * 4, NULL);
+                "max-buffers", (guint64)app->geometry.number,
+                "max-bytes", (guint64)bench_geometry_batch_size(&app->geometry), NULL);
 
     app->appsink = gst_bin_get_by_name(GST_BIN(app->pipeline), "mysink");
     g_assert(app->appsink);
     g_object_set(app->appsink,
-                "max-buffers", NUMBER,
+                "max-buffers", app->geometry.number,
                 "async", false, NULL);
 
-    app->data = g_malloc(WIDTH * HEIGHT * 4);
+    app->data = g_malloc(app->frame_size);
 }
 
 void cleanup()
@@ -241,23 +267,29 @@ outbuf_unref_callback (gpointer data)
   } \
 } while (0)
 
-gint test()
+gint64 test(gpointer user_data)
 {
+    (void)user_data;
+
     App* app = &s_app;
 
-    app->buffer = gst_buffer_list_new_sized(NUMBER);
+    GstVideoFormat format;
+    NvBufSurfaceColorFormat color;
+
+    nvbuf_format(app->geometry.format, &format, &color);
+    app->buffer = gst_buffer_list_new_sized(app->geometry.number);
 
     gst_buffer_list_make_writable(app->buffer);
-    for (guint i = 0; i < NUMBER; i++)
+    for (guint i = 0; i < app->geometry.number; i++)
     {
         NvBufSurfaceCreateParams params;
         CHECK_CUDA_STATUS (cudaSetDevice(0), "Unable to set cuda device");
         params.gpuId = 0;
-        params.width = WIDTH;
-        params.height = HEIGHT;
-        params.size = HEIGHT * WIDTH * 4;
+        params.width = app->geometry.width;
+        params.height = app->geometry.height;
+        params.size = app->frame_size;
         params.isContiguous = FALSE;
-        params.colorFormat = NVBUF_COLOR_FORMAT_RGBA;
+        params.colorFormat = color;
         params.layout = NVBUF_LAYOUT_PITCH;
         params.memType = NVBUF_MEM_CUDA_UNIFIED;
 
@@ -279,7 +311,7 @@ gint test()
         gst_buffer_list_add(app->buffer, buffer);
     }
     
-    auto t1 = std::chrono::high_resolution_clock::now();
+    gint64 t1 = bench_now_ns();
 
     /* go to playing and wait in a mainloop. */
     gst_element_set_state(app->pipeline, GST_STATE_PLAYING);
@@ -292,7 +324,7 @@ gint test()
         GST_DEBUG("failed to push buffers %d", ret);
     }
 
-    for (gint i = 0; i < NUMBER; i++)
+    for (guint i = 0; i < app->geometry.number; i++)
     {
         GstSample* sample = gst_app_sink_pull_sample(GST_APP_SINK(app->appsink));
         g_assert(sample);
@@ -301,53 +333,90 @@ gint test()
         gst_sample_unref(sample);
     }
 
-    auto t2 = std::chrono::high_resolution_clock::now();
+    gint64 t2 = bench_now_ns();
 
     GST_DEBUG("stopping");
 
     gst_element_set_state(app->pipeline, GST_STATE_NULL);
     gst_element_set_state(app->pipeline, GST_STATE_READY);
 
-    return std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+    return t2 - t1;
 }
 
 int
 main(int argc, char* argv[])
 {
+    BenchConfig config;
+    GError* error = NULL;
+
     gst_init(&argc, &argv);
 
     GST_DEBUG_CATEGORY_INIT(appsrc_pipeline_debug, "appsrc-pipeline", 0,
         "appsrc pipeline example");
-    
-    setup();
-
-    gint count = 3600;
-    glong sum = 0;
 
-    gint* values = new gint[count];
-    gint max = 0;
-    for (gint i = 0; i < count; i++)
+    bench_config_init(&config, WIDTH, HEIGHT, NUMBER, BENCH_FORMAT_RGBA);
+    if (!bench_config_parse(&config, "- DeepStream flip benchmark", NULL, &argc, &argv, &error))
     {
-        values[i] = test();
-        sum += values[i];
-        max = std::max(max, values[i]);
+        g_printerr("%s\n", error->message);
+        return 1;
     }
 
-    gdouble mean = (gdouble)sum / count;
+    App* app = &s_app;
+    GstVideoFormat format;
+    NvBufSurfaceColorFormat color;
 
-    gdouble sum2 = 0;
-    for (gint i = 0; i < count; i++)
+    for (guint g = 0; g < bench_config_get_n_geometries(&config); g++)
     {
-        sum2 += std::pow(values[i]- mean, 2);
+        const BenchGeometry* geometry = bench_config_get_geometry(&config, g);
+
+        if (!nvbuf_format(geometry->format, &format, &color))
+        {
+            g_printerr("format %s is not supported by nvvideoconvert\n", bench_format_to_string(geometry->format));
+            return 1;
+        }
     }
 
-    gdouble stdDev = std::sqrt(sum2 / (count - 1));
+    BenchReport* report = bench_report_new("deepstream");
+
+    /* what a stored report was measured against */
+    gchar* version = gst_version_string();
+    bench_report_set_info(report, "gstreamer", version);
+    g_free(version);
+    if (bench_config_get_n_geometries(&config) == 1)
+        bench_report_set_geometry(report, bench_config_get_geometry(&config, 0));
+    else
+        bench_report_set_info_int(report, "sweep", bench_config_get_n_geometries(&config));
+
+    bench_calibrate(&config, report);
+
+    for (guint g = 0; g < bench_config_get_n_geometries(&config); g++)
+    {
+        app->geometry = *bench_config_get_geometry(&config, g);
+        app->frame_size = bench_geometry_frame_size(&app->geometry);
 
-    std::cout << "Mean: " << mean << " ms" <<std::endl;
-    std::cout << "Standard Deviation: " << stdDev << " ms" << std::endl;
-    std::cout << "Max: " << max << " ms" <<std::endl;
+        gchar* name = bench_config_get_metric_name(&config, "run", &app->geometry);
+        BenchRecorder* run = bench_report_add_metric(report, name, config.iterations);
+        g_free(name);
+
+        setup();
+
+        bench_run(&config, run, test, NULL);
+        bench_baseline_compare(config.baseline, report, run, &app->geometry);
+
+        BenchStats stats;
+        bench_recorder_compute_stats(run, &stats);
+        name = bench_config_get_metric_name(&config, "Bandwidth", &app->geometry);
+        bench_report_set_bandwidth(report, name, 2.0 * bench_geometry_batch_size(&app->geometry), stats.p50);
+        g_free(name);
+
+        cleanup();
+    }
+
+    bench_finish(&config, report, &error);
+    check_error(&error);
 
-    cleanup();
+    bench_report_free(report);
+    bench_config_clear(&config);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include <string.h>
+
+#include "fastflip.h"
+
+/* Compiled once per instruction set, FAST_FLIP_SSE4 or FAST_FLIP_AVX2 pick
+ * the vector code, without either this is the scalar fallback */
+
+#if defined(FAST_FLIP_SSE4) || defined(FAST_FLIP_AVX2)
+#include <immintrin.h>
+
+/* pshufb masks reversing the pixels of a 16 byte lane */
+template <guint Bpp>
+static inline const guint8* reverse_mask();
+
+template <>
+inline const guint8*
+reverse_mask<1>()
+{
+    alignas(16) static const guint8 mask[16] = { 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 };
+    return mask;
+}
+
+template <>
+inline const guint8*
+reverse_mask<2>()
+{
+    alignas(16) static const guint8 mask[16] = { 14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1 };
+    return mask;
+}
+
+template <>
+inline const guint8*
+reverse_mask<4>()
+{
+    alignas(16) static const guint8 mask[16] = { 12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3 };
+    return mask;
+}
+#endif
+
+#if defined(FAST_FLIP_AVX2)
+#define FAST_FLIP_GET fast_flip_get_avx2
+
+/* pshufb works within 128 bit lanes, the lanes are swapped afterwards. Each
+ * build names its struct apart, the member templates are inline and would
+ * otherwise be merged across the objects by the linker */
+struct Avx2
+{
+    static const guint bytes = 32;
+
+    template <guint Bpp>
+    static inline __m256i
+    reverse(__m256i v)
+    {
+        const __m256i mask = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)reverse_mask<Bpp>()));
+
+        return _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, mask), 0x4E);
+    }
+
+    template <guint Bpp>
+    static inline void
+    swap(guint8* left, guint8* right)
+    {
+        __m256i l = _mm256_loadu_si256((const __m256i*)left);
+        __m256i r = _mm256_loadu_si256((const __m256i*)right);
+
+        _mm256_storeu_si256((__m256i*)left, reverse<Bpp>(r));
+        _mm256_storeu_si256((__m256i*)right, reverse<Bpp>(l));
+    }
+};
+typedef Avx2 Isa;
+#elif defined(FAST_FLIP_SSE4)
+#define FAST_FLIP_GET fast_flip_get_sse4
+
+struct Sse4
+{
+    static const guint bytes = 16;
+
+    template <guint Bpp>
+    static inline void
+    swap(guint8* left, guint8* right)
+    {
+        const __m128i mask = _mm_load_si128((const __m128i*)reverse_mask<Bpp>());
+        __m128i l = _mm_loadu_si128((const __m128i*)left);
+        __m128i r = _mm_loadu_si128((const __m128i*)right);
+
+        _mm_storeu_si128((__m128i*)left, _mm_shuffle_epi8(r, mask));
+        _mm_storeu_si128((__m128i*)right, _mm_shuffle_epi8(l, mask));
+    }
+};
+typedef Sse4 Isa;
+#else
+#define FAST_FLIP_GET fast_flip_get_scalar
+
+/* 4 bytes at a time in general purpose registers */
+struct Scalar
+{
+    static const guint bytes = 4;
+
+    template <guint Bpp>
+    static inline guint32
+    reverse(guint32 v)
+    {
+        if (Bpp == 1)
+            return GUINT32_SWAP_LE_BE(v);
+        if (Bpp == 2)
+            return (v >> 16) | (v << 16);
+        return v;
+    }
+
+    template <guint Bpp>
+    static inline void
+    swap(guint8* left, guint8* right)
+    {
+        guint32 l, r;
+
+        memcpy(&l, left, sizeof(l));
+        memcpy(&r, right, sizeof(r));
+        l = reverse<Bpp>(l);
+        r = reverse<Bpp>(r);
+        memcpy(left, &r, sizeof(r));
+        memcpy(right, &l, sizeof(l));
+    }
+};
+typedef Scalar Isa;
+#endif
+
+/* Swaps a vector from each end of the row and moves inwards, the middle that
+ * is left over is swapped pixel by pixel */
+template <guint Bpp>
+static void
+flip_rows(guint8* data, gsize stride, guint width, guint rows)
+{
+    const guint n = Isa::bytes / Bpp;
+
+    for (guint y = 0; y < rows; y++)
+    {
+        guint8* row = data + y * stride;
+        guint left = 0, right = width;
+
+        for (; right - left >= 2 * n; left += n, right -= n)
+            Isa::template swap<Bpp>(row + (gsize)left * Bpp, row + (gsize)(right - n) * Bpp);
+
+        for (; right - left >= 2; left++, right--)
+        {
+            guint8 pixel[Bpp];
+
+            memcpy(pixel, row + (gsize)left * Bpp, Bpp);
+            memcpy(row + (gsize)left * Bpp, row + (gsize)(right - 1) * Bpp, Bpp);
+            memcpy(row + (gsize)(right - 1) * Bpp, pixel, Bpp);
+        }
+    }
+}
+
+FastFlipFunc
+FAST_FLIP_GET(guint bpp)
+{
+    switch (bpp)
+    {
+    case 1:
+        return flip_rows<1>;
+    case 2:
+        return flip_rows<2>;
+    case 4:
+        return flip_rows<4>;
+    default:
+        return NULL;
+    }
+}
+
+#if !defined(FAST_FLIP_SSE4) && !defined(FAST_FLIP_AVX2)
+FastFlipFunc
+fast_flip_get(guint bpp)
+{
+#ifdef FAST_FLIP_X86
+    if (__builtin_cpu_supports("avx2"))
+        return fast_flip_get_avx2(bpp);
+    if (__builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1"))
+        return fast_flip_get_sse4(bpp);
+#endif
+
+    return fast_flip_get_scalar(bpp);
+}
+#endif
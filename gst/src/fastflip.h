@@ -0,0 +1,15 @@
+#pragma once
+
+#include <glib.h>
+
+/* Reverses rows of width bpp byte pixels in place */
+typedef void (*FastFlipFunc)(guint8* data, gsize stride, guint width, guint rows);
+
+/* fastflip-kernels.cpp built once per instruction set, NULL for unsupported
+ * pixel sizes */
+FastFlipFunc fast_flip_get_scalar(guint bpp);
+FastFlipFunc fast_flip_get_sse4(guint bpp);
+FastFlipFunc fast_flip_get_avx2(guint bpp);
+
+/* The fastest kernel the CPU supports */
+FastFlipFunc fast_flip_get(guint bpp);
@@ -0,0 +1,192 @@
+#include "gstarenaallocator.h"
+
+GST_DEBUG_CATEGORY_STATIC(gst_arena_allocator_debug);
+#define GST_CAT_DEFAULT gst_arena_allocator_debug
+
+G_DEFINE_TYPE(GstArenaAllocator, gst_arena_allocator, GST_TYPE_ALLOCATOR);
+
+#define ARENA_MEMORY_TYPE "ArenaMemory"
+#define NO_SLOT G_MAXUINT
+
+typedef struct _GstArenaMemory
+{
+    GstMemory memory;
+    guint8* data;
+    /* NO_SLOT for shared memories, the parent owns the slot */
+    guint slot;
+} GstArenaMemory;
+
+static GstArenaMemory*
+arena_memory_new(GstAllocator* allocator, GstMemory* parent, GstMemoryFlags flags, guint8* data, guint slot,
+    gsize maxsize, gsize align, gsize offset, gsize size)
+{
+    GstArenaMemory* memory = g_new(GstArenaMemory, 1);
+
+    gst_memory_init(GST_MEMORY_CAST(memory), flags, allocator, parent, maxsize, align, offset, size);
+    memory->data = data;
+    memory->slot = slot;
+
+    return memory;
+}
+
+static GstMemory*
+gst_arena_allocator_alloc(GstAllocator* allocator, gsize size, GstAllocationParams* params)
+{
+    GstArenaAllocator* self = GST_ARENA_ALLOCATOR(allocator);
+    gsize maxsize = size + params->prefix + params->padding;
+    guint slot = NO_SLOT;
+
+    /* slots are page aligned, which covers any alignment GStreamer asks for */
+    if (maxsize <= self->slot_size)
+    {
+        g_mutex_lock(&self->lock);
+        if (self->n_free > 0)
+            slot = self->free_slots[--self->n_free];
+        g_mutex_unlock(&self->lock);
+    }
+
+    if (slot == NO_SLOT)
+    {
+        self->fallbacks.fetch_add(1, std::memory_order_relaxed);
+        return gst_allocator_alloc(NULL, size, params);
+    }
+
+    guint8* data = self->arena->data + (gsize)slot * self->slot_size;
+    GstArenaMemory* memory = arena_memory_new(allocator, NULL, params->flags, data, slot,
+        self->slot_size, params->align, params->prefix, size);
+
+    if (params->flags & GST_MEMORY_FLAG_ZERO_PREFIXED)
+        memset(data, 0, params->prefix);
+    if (params->flags & GST_MEMORY_FLAG_ZERO_PADDED)
+        memset(data + params->prefix + size, 0, self->slot_size - params->prefix - size);
+
+    return GST_MEMORY_CAST(memory);
+}
+
+static void
+gst_arena_allocator_free(GstAllocator* allocator, GstMemory* memory)
+{
+    GstArenaAllocator* self = GST_ARENA_ALLOCATOR(allocator);
+    GstArenaMemory* arena_memory = (GstArenaMemory*)memory;
+
+    if (arena_memory->slot != NO_SLOT)
+    {
+        g_mutex_lock(&self->lock);
+        self->free_slots[self->n_free++] = arena_memory->slot;
+        g_mutex_unlock(&self->lock);
+    }
+
+    g_free(arena_memory);
+}
+
+static gpointer
+arena_memory_map(GstMemory* memory, gsize maxsize, GstMapFlags flags)
+{
+    (void)maxsize;
+    (void)flags;
+
+    return ((GstArenaMemory*)memory)->data;
+}
+
+static void
+arena_memory_unmap(GstMemory* memory)
+{
+    (void)memory;
+}
+
+static GstMemory*
+arena_memory_share(GstMemory* memory, gssize offset, gssize size)
+{
+    GstArenaMemory* arena_memory = (GstArenaMemory*)memory;
+    GstMemory* parent = memory->parent != NULL ? memory->parent : memory;
+
+    if (size == -1)
+        size = memory->size - offset;
+
+    GstArenaMemory* shared = arena_memory_new(memory->allocator, parent,
+        (GstMemoryFlags)(GST_MINI_OBJECT_FLAGS(parent) | GST_MINI_OBJECT_FLAG_LOCK_READONLY),
+        arena_memory->data, NO_SLOT, memory->maxsize, memory->align, memory->offset + offset, size);
+
+    return GST_MEMORY_CAST(shared);
+}
+
+static gboolean
+arena_memory_is_span(GstMemory* first, GstMemory* second, gsize* offset)
+{
+    GstArenaMemory* a = (GstArenaMemory*)first;
+    GstArenaMemory* b = (GstArenaMemory*)second;
+
+    if (offset != NULL)
+        *offset = first->offset;
+
+    return a->data + first->offset + first->size == b->data + second->offset;
+}
+
+GstAllocator*
+gst_arena_allocator_new(gsize frame_size, guint n_slots, BenchPages pages, gboolean populate, gint node,
+    GError** error)
+{
+    /* page aligned slots, frames never share a page */
+    gsize slot_size = (frame_size + 4095) / 4096 * 4096;
+    BenchArena* arena = bench_arena_new(slot_size * n_slots, pages, populate, node, error);
+
+    if (arena == NULL)
+        return NULL;
+
+    GstArenaAllocator* self = GST_ARENA_ALLOCATOR(gst_object_ref_sink(g_object_new(GST_TYPE_ARENA_ALLOCATOR, NULL)));
+
+    self->arena = arena;
+    self->slot_size = slot_size;
+    self->n_slots = n_slots;
+    self->free_slots = g_new(guint, n_slots);
+
+    /* handed out from the start of the arena */
+    for (guint i = 0; i < n_slots; i++)
+        self->free_slots[i] = n_slots - 1 - i;
+    self->n_free = n_slots;
+
+    GST_DEBUG_OBJECT(self, "%u slots of %" G_GSIZE_FORMAT " bytes on %s pages", n_slots, slot_size,
+        bench_pages_to_string(arena->pages));
+
+    return GST_ALLOCATOR(self);
+}
+
+static void
+gst_arena_allocator_finalize(GObject* object)
+{
+    GstArenaAllocator* self = GST_ARENA_ALLOCATOR(object);
+
+    if (self->arena != NULL)
+        bench_arena_free(self->arena);
+    g_free(self->free_slots);
+    g_mutex_clear(&self->lock);
+
+    G_OBJECT_CLASS(gst_arena_allocator_parent_class)->finalize(object);
+}
+
+static void
+gst_arena_allocator_class_init(GstArenaAllocatorClass* klass)
+{
+    GObjectClass* gobject_class = G_OBJECT_CLASS(klass);
+    GstAllocatorClass* allocator_class = GST_ALLOCATOR_CLASS(klass);
+
+    gobject_class->finalize = gst_arena_allocator_finalize;
+    allocator_class->alloc = gst_arena_allocator_alloc;
+    allocator_class->free = gst_arena_allocator_free;
+
+    GST_DEBUG_CATEGORY_INIT(gst_arena_allocator_debug, "arenaallocator", 0, "hugepage frame arena");
+}
+
+static void
+gst_arena_allocator_init(GstArenaAllocator* self)
+{
+    GstAllocator* allocator = GST_ALLOCATOR(self);
+
+    allocator->mem_type = ARENA_MEMORY_TYPE;
+    allocator->mem_map = arena_memory_map;
+    allocator->mem_unmap = arena_memory_unmap;
+    allocator->mem_share = arena_memory_share;
+    allocator->mem_is_span = arena_memory_is_span;
+
+    g_mutex_init(&self->lock);
+}
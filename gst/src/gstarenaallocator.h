@@ -0,0 +1,46 @@
+#pragma once
+
+#include <gst/gst.h>
+#include <benchcore/bench.h>
+#include <atomic>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_ARENA_ALLOCATOR (gst_arena_allocator_get_type())
+#define GST_ARENA_ALLOCATOR(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_ARENA_ALLOCATOR, GstArenaAllocator))
+
+typedef struct _GstArenaAllocator GstArenaAllocator;
+typedef struct _GstArenaAllocatorClass GstArenaAllocatorClass;
+
+/* Hands out fixed size slots of one BenchArena, so every frame lives on
+ * hugepages. A slot goes back on the free list once its memory is freed.
+ * Larger requests and allocations beyond the last slot come from the system
+ * allocator and are counted */
+struct _GstArenaAllocator
+{
+    GstAllocator parent;
+
+    BenchArena* arena;
+    gsize slot_size;
+    guint n_slots;
+
+    GMutex lock;
+    guint* free_slots;
+    guint n_free;
+
+    std::atomic<guint64> fallbacks;
+};
+
+struct _GstArenaAllocatorClass
+{
+    GstAllocatorClass parent_class;
+};
+
+GType gst_arena_allocator_get_type();
+
+/* n_slots frames of frame_size, see bench_arena_new() for pages, populate
+ * and node */
+GstAllocator* gst_arena_allocator_new(gsize frame_size, guint n_slots, BenchPages pages, gboolean populate, gint node,
+    GError** error);
+
+G_END_DECLS
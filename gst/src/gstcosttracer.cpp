@@ -0,0 +1,413 @@
+#include "gstcosttracer.h"
+
+GST_DEBUG_CATEGORY_STATIC(gst_cost_tracer_debug);
+#define GST_CAT_DEFAULT gst_cost_tracer_debug
+
+G_DEFINE_TYPE(GstCostTracer, gst_cost_tracer, GST_TYPE_TRACER);
+
+#define COST_STACK_DEPTH 32
+#define LIFETIME_PROBES 64
+#define LIFETIME_TOMBSTONE ((gpointer)1)
+
+/* Pushes and pulls nest on the thread doing them, a frame is open while the
+ * receiving element works on it. Its own time is its duration minus that of
+ * the pushes it made itself */
+typedef struct _CostFrame
+{
+    GstCostElement* element;
+    guint64 start;
+    guint64 child;
+    guint buffers;
+} CostFrame;
+
+static thread_local CostFrame cost_stack[COST_STACK_DEPTH];
+static thread_local guint cost_depth;
+
+static GstCostElement*
+get_element(GstCostTracer* self, GstElement* element)
+{
+    if (element == NULL)
+        return NULL;
+
+    for (guint i = 0; i < GST_COST_TRACER_MAX_ELEMENTS; i++)
+    {
+        GstCostElement* slot = &self->elements[i];
+        GstElement* current = slot->element.load(std::memory_order_acquire);
+
+        if (current == element)
+            return slot;
+
+        if (current == NULL)
+        {
+            if (slot->element.compare_exchange_strong(current, element, std::memory_order_acq_rel))
+                return slot;
+            if (current == element)
+                return slot;
+        }
+    }
+
+    return NULL;
+}
+
+/* Samples the queue of appsrc and queue whenever they push a buffer */
+static void
+sample_level(GstCostTracer* self, GstPad* pad)
+{
+    GstCostElement* slot = get_element(self, GST_ELEMENT_CAST(GST_OBJECT_PARENT(pad)));
+
+    if (slot == NULL)
+        return;
+
+    gint has_level = slot->has_level.load(std::memory_order_relaxed);
+    if (has_level < 0)
+    {
+        GstElement* element = slot->element.load(std::memory_order_relaxed);
+
+        has_level = g_object_class_find_property(G_OBJECT_GET_CLASS(element), "current-level-buffers") != NULL;
+        slot->has_level.store(has_level, std::memory_order_relaxed);
+    }
+    if (!has_level)
+        return;
+
+    /* guint64 on appsrc, guint on queue */
+    GValue value = G_VALUE_INIT;
+    g_value_init(&value, G_TYPE_UINT64);
+    g_object_get_property(G_OBJECT(slot->element.load(std::memory_order_relaxed)), "current-level-buffers", &value);
+    guint64 level = g_value_get_uint64(&value);
+
+    slot->level_sum.fetch_add(level, std::memory_order_relaxed);
+    slot->level_samples.fetch_add(1, std::memory_order_relaxed);
+
+    guint64 max = slot->level_max.load(std::memory_order_relaxed);
+    while (level > max && !slot->level_max.compare_exchange_weak(max, level, std::memory_order_relaxed))
+        ;
+}
+
+static void
+enter(GstCostTracer* self, guint64 ts, GstPad* peer, guint buffers)
+{
+    guint depth = cost_depth++;
+
+    if (depth >= COST_STACK_DEPTH)
+        return;
+
+    GstObject* parent = peer != NULL ? GST_OBJECT_PARENT(peer) : NULL;
+    CostFrame* frame = &cost_stack[depth];
+
+    frame->element = GST_IS_ELEMENT(parent) ? get_element(self, GST_ELEMENT_CAST(parent)) : NULL;
+    frame->start = ts;
+    frame->child = 0;
+    frame->buffers = buffers;
+}
+
+static void
+leave(guint64 ts)
+{
+    if (cost_depth == 0)
+        return;
+
+    guint depth = --cost_depth;
+
+    if (depth >= COST_STACK_DEPTH)
+        return;
+
+    CostFrame* frame = &cost_stack[depth];
+    guint64 duration = ts - frame->start;
+
+    if (frame->element != NULL)
+    {
+        frame->element->self_ns.fetch_add(duration - MIN(frame->child, duration), std::memory_order_relaxed);
+        frame->element->buffers.fetch_add(frame->buffers, std::memory_order_relaxed);
+    }
+
+    if (depth > 0 && depth - 1 < COST_STACK_DEPTH)
+        cost_stack[depth - 1].child += duration;
+}
+
+static void
+do_push_buffer_pre(GstCostTracer* self, guint64 ts, GstPad* pad, GstBuffer* buffer)
+{
+    (void)buffer;
+
+    sample_level(self, pad);
+    enter(self, ts, GST_PAD_PEER(pad), 1);
+}
+
+static void
+do_push_list_pre(GstCostTracer* self, guint64 ts, GstPad* pad, GstBufferList* list)
+{
+    sample_level(self, pad);
+    enter(self, ts, GST_PAD_PEER(pad), gst_buffer_list_length(list));
+}
+
+static void
+do_push_post(GstCostTracer* self, guint64 ts, GstPad* pad, GstFlowReturn res)
+{
+    (void)self;
+    (void)pad;
+    (void)res;
+
+    leave(ts);
+}
+
+/* pad is the pulling sink pad, the upstream element does the work */
+static void
+do_pull_range_pre(GstCostTracer* self, guint64 ts, GstPad* pad, guint64 offset, guint size)
+{
+    (void)offset;
+    (void)size;
+
+    enter(self, ts, GST_PAD_PEER(pad), 1);
+}
+
+static void
+do_pull_range_post(GstCostTracer* self, guint64 ts, GstPad* pad, GstBuffer* buffer, GstFlowReturn res)
+{
+    (void)self;
+    (void)pad;
+    (void)buffer;
+    (void)res;
+
+    leave(ts);
+}
+
+static guint
+lifetime_hash(gpointer buffer)
+{
+    return (guint)((((guint64)(guintptr)buffer >> 4) * G_GUINT64_CONSTANT(0x9E3779B97F4A7C15)) >> 48);
+}
+
+static void
+do_mini_object_created(GstCostTracer* self, guint64 ts, GstMiniObject* object)
+{
+    if (!GST_IS_BUFFER(object))
+        return;
+
+    self->buffers_created.fetch_add(1, std::memory_order_relaxed);
+
+    guint index = lifetime_hash(object);
+    for (guint i = 0; i < LIFETIME_PROBES; i++)
+    {
+        GstCostLifetime* slot = &self->lifetimes[(index + i) % GST_COST_TRACER_LIFETIME_SLOTS];
+        gpointer current = slot->buffer.load(std::memory_order_relaxed);
+
+        if ((current == NULL || current == LIFETIME_TOMBSTONE) &&
+            slot->buffer.compare_exchange_strong(current, object, std::memory_order_acq_rel))
+        {
+            slot->born.store(ts, std::memory_order_release);
+            return;
+        }
+    }
+
+    self->untracked.fetch_add(1, std::memory_order_relaxed);
+}
+
+/* Pooled buffers only die when their pool is freed, released buffers go back
+ * to the pool without passing here */
+static void
+do_mini_object_destroyed(GstCostTracer* self, guint64 ts, GstMiniObject* object)
+{
+    if (!GST_IS_BUFFER(object))
+        return;
+
+    guint index = lifetime_hash(object);
+    for (guint i = 0; i < LIFETIME_PROBES; i++)
+    {
+        GstCostLifetime* slot = &self->lifetimes[(index + i) % GST_COST_TRACER_LIFETIME_SLOTS];
+        gpointer current = slot->buffer.load(std::memory_order_acquire);
+
+        if (current == NULL)
+            return;
+
+        if (current == (gpointer)object)
+        {
+            guint64 lifetime = ts - slot->born.load(std::memory_order_acquire);
+
+            slot->buffer.store(LIFETIME_TOMBSTONE, std::memory_order_release);
+            self->lifetime_sum.fetch_add(lifetime, std::memory_order_relaxed);
+            self->lifetime_count.fetch_add(1, std::memory_order_relaxed);
+            self->lifetime_buckets[bench_histogram_index(lifetime)].fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+#if GST_CHECK_VERSION(1, 18, 0)
+static void
+do_memory_init(GstCostTracer* self, guint64 ts, GstMemory* memory)
+{
+    (void)ts;
+
+    self->memories_created.fetch_add(1, std::memory_order_relaxed);
+    self->memory_bytes.fetch_add(memory->maxsize, std::memory_order_relaxed);
+}
+#endif
+
+GstCostTracer*
+gst_cost_tracer_new()
+{
+    return GST_COST_TRACER(gst_object_ref_sink(g_object_new(GST_TYPE_COST_TRACER, NULL)));
+}
+
+void
+gst_cost_tracer_reset(GstCostTracer* self)
+{
+    for (guint i = 0; i < GST_COST_TRACER_MAX_ELEMENTS; i++)
+    {
+        GstCostElement* slot = &self->elements[i];
+
+        slot->element = NULL;
+        slot->has_level = -1;
+        slot->self_ns = 0;
+        slot->buffers = 0;
+        slot->level_sum = 0;
+        slot->level_samples = 0;
+        slot->level_max = 0;
+    }
+
+    for (guint i = 0; i < GST_COST_TRACER_LIFETIME_SLOTS; i++)
+        self->lifetimes[i].buffer = NULL;
+    for (guint i = 0; i < BENCH_HISTOGRAM_BUCKETS; i++)
+        self->lifetime_buckets[i] = 0;
+
+    self->buffers_created = 0;
+    self->memories_created = 0;
+    self->memory_bytes = 0;
+    self->lifetime_sum = 0;
+    self->lifetime_count = 0;
+    self->untracked = 0;
+}
+
+static void
+set_value(BenchReport* report, const BenchConfig* config, const BenchGeometry* geometry,
+    const gchar* name, gdouble value, const gchar* unit)
+{
+    gchar* full = bench_config_get_metric_name(config, name, geometry);
+
+    bench_report_set_value(report, full, value, unit);
+    g_free(full);
+}
+
+/* Lower bound of the bucket holding the p-th lifetime */
+static guint64
+lifetime_percentile(GstCostTracer* self, gdouble p)
+{
+    guint64 count = self->lifetime_count, target = (guint64)(p * count), seen = 0;
+
+    for (guint i = 0; i < BENCH_HISTOGRAM_BUCKETS; i++)
+    {
+        seen += self->lifetime_buckets[i];
+        if (seen > target)
+            return bench_histogram_lower_bound(i);
+    }
+
+    return 0;
+}
+
+void
+gst_cost_tracer_report(GstCostTracer* self, BenchReport* report, const BenchConfig* config,
+    const BenchGeometry* geometry, guint64 frames)
+{
+    guint64 total = 0;
+
+    for (guint i = 0; i < GST_COST_TRACER_MAX_ELEMENTS; i++)
+        total += self->elements[i].self_ns;
+
+    for (guint i = 0; i < GST_COST_TRACER_MAX_ELEMENTS; i++)
+    {
+        GstCostElement* slot = &self->elements[i];
+        GstElement* element = slot->element;
+
+        if (element == NULL)
+            break;
+
+        GstElementFactory* factory = gst_element_get_factory(element);
+        const gchar* label = factory != NULL ? GST_OBJECT_NAME(factory) : GST_OBJECT_NAME(element);
+        guint64 self_ns = slot->self_ns, buffers = slot->buffers;
+        gchar* name;
+
+        /* sources do their work outside of any push */
+        if (buffers > 0)
+        {
+            name = g_strdup_printf("Cost %s", label);
+            set_value(report, config, geometry, name, self_ns / 1e3 / buffers, "us/buffer");
+            g_free(name);
+
+            name = g_strdup_printf("Cost %s Share", label);
+            set_value(report, config, geometry, name, total > 0 ? 100.0 * self_ns / total : 0, "%");
+            g_free(name);
+        }
+
+        if (slot->level_samples > 0)
+        {
+            name = g_strdup_printf("Level %s", label);
+            set_value(report, config, geometry, name, (gdouble)slot->level_sum / slot->level_samples, "buffers");
+            g_free(name);
+
+            name = g_strdup_printf("Level %s Max", label);
+            set_value(report, config, geometry, name, slot->level_max, "buffers");
+            g_free(name);
+        }
+    }
+
+    gdouble per_frame = frames > 0 ? 1.0 / frames : 0;
+
+    set_value(report, config, geometry, "Buffers Allocated", self->buffers_created * per_frame, "buffers/frame");
+#if GST_CHECK_VERSION(1, 18, 0)
+    set_value(report, config, geometry, "Memories Allocated", self->memories_created * per_frame, "memories/frame");
+    set_value(report, config, geometry, "Memory Allocated", self->memory_bytes * per_frame, "bytes/frame");
+#endif
+
+    if (self->lifetime_count > 0)
+    {
+        set_value(report, config, geometry, "Buffer Lifetime", (gdouble)self->lifetime_sum / self->lifetime_count / 1e6, "ms");
+        set_value(report, config, geometry, "Buffer Lifetime P99", lifetime_percentile(self, 0.99) / 1e6, "ms");
+    }
+
+    if (self->untracked > 0)
+        GST_WARNING("%" G_GUINT64_FORMAT " buffers were created while the lifetime table was full", (guint64)self->untracked);
+}
+
+static void
+gst_cost_tracer_finalize(GObject* object)
+{
+    GstCostTracer* self = GST_COST_TRACER(object);
+
+    g_free(self->lifetimes);
+    g_free(self->lifetime_buckets);
+
+    G_OBJECT_CLASS(gst_cost_tracer_parent_class)->finalize(object);
+}
+
+static void
+gst_cost_tracer_class_init(GstCostTracerClass* klass)
+{
+    GObjectClass* gobject_class = G_OBJECT_CLASS(klass);
+
+    gobject_class->finalize = gst_cost_tracer_finalize;
+
+    GST_DEBUG_CATEGORY_INIT(gst_cost_tracer_debug, "costtracer", 0, "per element cost tracer");
+}
+
+static void
+gst_cost_tracer_init(GstCostTracer* self)
+{
+    GstTracer* tracer = GST_TRACER(self);
+
+    /* zeroed memory is a valid state for the atomics */
+    self->lifetimes = g_new0(GstCostLifetime, GST_COST_TRACER_LIFETIME_SLOTS);
+    self->lifetime_buckets = g_new0(std::atomic<guint64>, BENCH_HISTOGRAM_BUCKETS);
+    gst_cost_tracer_reset(self);
+
+    gst_tracing_register_hook(tracer, "pad-push-pre", G_CALLBACK(do_push_buffer_pre));
+    gst_tracing_register_hook(tracer, "pad-push-post", G_CALLBACK(do_push_post));
+    gst_tracing_register_hook(tracer, "pad-push-list-pre", G_CALLBACK(do_push_list_pre));
+    gst_tracing_register_hook(tracer, "pad-push-list-post", G_CALLBACK(do_push_post));
+    gst_tracing_register_hook(tracer, "pad-pull-range-pre", G_CALLBACK(do_pull_range_pre));
+    gst_tracing_register_hook(tracer, "pad-pull-range-post", G_CALLBACK(do_pull_range_post));
+    gst_tracing_register_hook(tracer, "mini-object-created", G_CALLBACK(do_mini_object_created));
+    gst_tracing_register_hook(tracer, "mini-object-destroyed", G_CALLBACK(do_mini_object_destroyed));
+#if GST_CHECK_VERSION(1, 18, 0)
+    gst_tracing_register_hook(tracer, "memory-init", G_CALLBACK(do_memory_init));
+#endif
+}
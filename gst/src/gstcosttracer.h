@@ -0,0 +1,80 @@
+#pragma once
+
+#include <gst/gst.h>
+#include <benchcore/bench.h>
+#include <atomic>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_COST_TRACER (gst_cost_tracer_get_type())
+#define GST_COST_TRACER(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_COST_TRACER, GstCostTracer))
+
+#define GST_COST_TRACER_MAX_ELEMENTS 16
+#define GST_COST_TRACER_LIFETIME_SLOTS (1 << 16)
+
+typedef struct _GstCostTracer GstCostTracer;
+typedef struct _GstCostTracerClass GstCostTracerClass;
+typedef struct _GstCostElement GstCostElement;
+typedef struct _GstCostLifetime GstCostLifetime;
+
+/* Counters of one element, claimed by the first thread that sees it */
+struct _GstCostElement
+{
+    std::atomic<GstElement*> element;
+    /* -1 until known whether it has a current-level-buffers property */
+    std::atomic<gint> has_level;
+
+    std::atomic<guint64> self_ns;
+    std::atomic<guint64> buffers;
+
+    std::atomic<guint64> level_sum;
+    std::atomic<guint64> level_samples;
+    std::atomic<guint64> level_max;
+};
+
+/* Creation time of a live buffer in an open addressing table */
+struct _GstCostLifetime
+{
+    std::atomic<gpointer> buffer;
+    std::atomic<guint64> born;
+};
+
+/* Per element processing time, queue levels, buffer allocations and buffer
+ * lifetimes. The hooks only touch atomic counters, so the streaming threads
+ * never wait on the tracer */
+struct _GstCostTracer
+{
+    GstTracer parent;
+
+    GstCostElement elements[GST_COST_TRACER_MAX_ELEMENTS];
+
+    std::atomic<guint64> buffers_created;
+    std::atomic<guint64> memories_created;
+    std::atomic<guint64> memory_bytes;
+
+    GstCostLifetime* lifetimes;
+    std::atomic<guint64> lifetime_sum;
+    std::atomic<guint64> lifetime_count;
+    std::atomic<guint64> untracked;
+    std::atomic<guint64>* lifetime_buckets;
+};
+
+struct _GstCostTracerClass
+{
+    GstTracerClass parent_class;
+};
+
+GType gst_cost_tracer_get_type();
+
+/* Creates the tracer and hooks it up, no GST_TRACERS needed */
+GstCostTracer* gst_cost_tracer_new();
+
+/* Only while no pipeline is streaming */
+void gst_cost_tracer_reset(GstCostTracer* self);
+
+/* Adds the counters to the report, per frame values are divided by frames.
+ * The elements must still be alive */
+void gst_cost_tracer_report(GstCostTracer* self, BenchReport* report, const BenchConfig* config,
+    const BenchGeometry* geometry, guint64 frames);
+
+G_END_DECLS
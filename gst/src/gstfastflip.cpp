@@ -0,0 +1,225 @@
+#include "gstfastflip.h"
+
+GST_DEBUG_CATEGORY_STATIC(gst_fast_flip_debug);
+#define GST_CAT_DEFAULT gst_fast_flip_debug
+
+enum
+{
+    PROP_0,
+    PROP_THREADS,
+};
+
+/* the formats the harness can produce */
+#define FAST_FLIP_CAPS GST_VIDEO_CAPS_MAKE("{ RGBA, GRAY8, GRAY16_LE }")
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE("sink",
+    GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS(FAST_FLIP_CAPS));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE("src",
+    GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS(FAST_FLIP_CAPS));
+
+G_DEFINE_TYPE(GstFastFlip, gst_fast_flip, GST_TYPE_VIDEO_FILTER);
+
+static void
+flip_slice(gpointer data, gpointer user_data)
+{
+    GstFastFlipSlice* slice = (GstFastFlipSlice*)data;
+    GstFastFlip* self = slice->self;
+
+    (void)user_data;
+
+    self->func(slice->data, slice->stride, slice->width, slice->rows);
+
+    g_mutex_lock(&self->lock);
+    if (--self->pending == 0)
+        g_cond_signal(&self->cond);
+    g_mutex_unlock(&self->lock);
+}
+
+static gboolean
+gst_fast_flip_start(GstBaseTransform* trans)
+{
+    GstFastFlip* self = GST_FAST_FLIP(trans);
+    GError* error = NULL;
+
+    if (self->threads <= 1)
+        return TRUE;
+
+    /* the streaming thread takes the first slice itself */
+    self->pool = g_thread_pool_new(flip_slice, NULL, self->threads - 1, TRUE, &error);
+    if (self->pool == NULL)
+    {
+        GST_ELEMENT_ERROR(self, RESOURCE, FAILED, ("could not start %u threads", self->threads), ("%s", error->message));
+        g_error_free(error);
+        return FALSE;
+    }
+    self->slices = g_new0(GstFastFlipSlice, self->threads);
+
+    return TRUE;
+}
+
+static gboolean
+gst_fast_flip_stop(GstBaseTransform* trans)
+{
+    GstFastFlip* self = GST_FAST_FLIP(trans);
+
+    if (self->pool != NULL)
+        g_thread_pool_free(self->pool, FALSE, TRUE);
+    g_free(self->slices);
+    self->pool = NULL;
+    self->slices = NULL;
+
+    return TRUE;
+}
+
+static gboolean
+gst_fast_flip_set_info(GstVideoFilter* filter, GstCaps* incaps, GstVideoInfo* in_info,
+    GstCaps* outcaps, GstVideoInfo* out_info)
+{
+    GstFastFlip* self = GST_FAST_FLIP(filter);
+
+    (void)incaps;
+    (void)outcaps;
+    (void)out_info;
+
+    self->func = fast_flip_get(GST_VIDEO_INFO_COMP_PSTRIDE(in_info, 0));
+
+    return self->func != NULL;
+}
+
+static GstFlowReturn
+gst_fast_flip_transform_frame_ip(GstVideoFilter* filter, GstVideoFrame* frame)
+{
+    GstFastFlip* self = GST_FAST_FLIP(filter);
+    guint8* data = (guint8*)GST_VIDEO_FRAME_PLANE_DATA(frame, 0);
+    gsize stride = GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0);
+    guint width = GST_VIDEO_FRAME_WIDTH(frame);
+    guint height = GST_VIDEO_FRAME_HEIGHT(frame);
+    guint n = MIN(self->threads, height);
+
+    if (self->pool == NULL || n <= 1)
+    {
+        self->func(data, stride, width, height);
+        return GST_FLOW_OK;
+    }
+
+    for (guint i = 0; i < n; i++)
+    {
+        GstFastFlipSlice* slice = &self->slices[i];
+        guint first = height * i / n;
+
+        slice->self = self;
+        slice->data = data + first * stride;
+        slice->stride = stride;
+        slice->width = width;
+        slice->rows = height * (i + 1) / n - first;
+    }
+
+    self->pending = n;
+    for (guint i = 1; i < n; i++)
+        g_thread_pool_push(self->pool, &self->slices[i], NULL);
+    flip_slice(&self->slices[0], NULL);
+
+    g_mutex_lock(&self->lock);
+    while (self->pending > 0)
+        g_cond_wait(&self->cond, &self->lock);
+    g_mutex_unlock(&self->lock);
+
+    return GST_FLOW_OK;
+}
+
+static void
+gst_fast_flip_set_property(GObject* object, guint prop_id, const GValue* value, GParamSpec* pspec)
+{
+    GstFastFlip* self = GST_FAST_FLIP(object);
+
+    switch (prop_id)
+    {
+    case PROP_THREADS:
+        self->threads = g_value_get_uint(value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+gst_fast_flip_get_property(GObject* object, guint prop_id, GValue* value, GParamSpec* pspec)
+{
+    GstFastFlip* self = GST_FAST_FLIP(object);
+
+    switch (prop_id)
+    {
+    case PROP_THREADS:
+        g_value_set_uint(value, self->threads);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+gst_fast_flip_finalize(GObject* object)
+{
+    GstFastFlip* self = GST_FAST_FLIP(object);
+
+    g_mutex_clear(&self->lock);
+    g_cond_clear(&self->cond);
+
+    G_OBJECT_CLASS(gst_fast_flip_parent_class)->finalize(object);
+}
+
+static void
+gst_fast_flip_class_init(GstFastFlipClass* klass)
+{
+    GObjectClass* gobject_class = G_OBJECT_CLASS(klass);
+    GstElementClass* element_class = GST_ELEMENT_CLASS(klass);
+    GstBaseTransformClass* trans_class = GST_BASE_TRANSFORM_CLASS(klass);
+    GstVideoFilterClass* filter_class = GST_VIDEO_FILTER_CLASS(klass);
+
+    gobject_class->set_property = gst_fast_flip_set_property;
+    gobject_class->get_property = gst_fast_flip_get_property;
+    gobject_class->finalize = gst_fast_flip_finalize;
+
+    g_object_class_install_property(gobject_class, PROP_THREADS,
+        g_param_spec_uint("threads", "Threads", "Threads each frame is split over by rows",
+            1, G_MAXUINT16, 1, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+
+    gst_element_class_set_static_metadata(element_class, "Fast flip", "Filter/Effect/Video",
+        "Flips video horizontally in place with SIMD row reversal", "gst-test");
+    gst_element_class_add_static_pad_template(element_class, &sink_template);
+    gst_element_class_add_static_pad_template(element_class, &src_template);
+
+    trans_class->start = GST_DEBUG_FUNCPTR(gst_fast_flip_start);
+    trans_class->stop = GST_DEBUG_FUNCPTR(gst_fast_flip_stop);
+    filter_class->set_info = GST_DEBUG_FUNCPTR(gst_fast_flip_set_info);
+    filter_class->transform_frame_ip = GST_DEBUG_FUNCPTR(gst_fast_flip_transform_frame_ip);
+}
+
+static void
+gst_fast_flip_init(GstFastFlip* self)
+{
+    self->threads = 1;
+    g_mutex_init(&self->lock);
+    g_cond_init(&self->cond);
+
+    /* there is no transform_frame, the frame is always flipped in place */
+    gst_base_transform_set_in_place(GST_BASE_TRANSFORM(self), TRUE);
+}
+
+static gboolean
+plugin_init(GstPlugin* plugin)
+{
+    GST_DEBUG_CATEGORY_INIT(gst_fast_flip_debug, "fastflip", 0, "in place SIMD flip");
+
+    return gst_element_register(plugin, "fastflip", GST_RANK_NONE, GST_TYPE_FAST_FLIP);
+}
+
+gboolean
+gst_fast_flip_register()
+{
+    return gst_plugin_register_static(GST_VERSION_MAJOR, GST_VERSION_MINOR, "fastflip",
+        "In place SIMD flip", plugin_init, "0.1", "LGPL", "gst-test", "gst-test", "gst-test");
+}
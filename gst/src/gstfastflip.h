@@ -0,0 +1,54 @@
+#pragma once
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+
+#include "fastflip.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_FAST_FLIP (gst_fast_flip_get_type())
+#define GST_FAST_FLIP(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_FAST_FLIP, GstFastFlip))
+
+typedef struct _GstFastFlip GstFastFlip;
+typedef struct _GstFastFlipClass GstFastFlipClass;
+typedef struct _GstFastFlipSlice GstFastFlipSlice;
+
+/* Rows of one frame handed to a worker */
+struct _GstFastFlipSlice
+{
+    GstFastFlip* self;
+    guint8* data;
+    gsize stride;
+    guint width;
+    guint rows;
+};
+
+/* Horizontal flip that works in place on the input buffer, optionally split
+ * into row slices over a thread pool */
+struct _GstFastFlip
+{
+    GstVideoFilter parent;
+
+    guint threads;
+    FastFlipFunc func;
+
+    GThreadPool* pool;
+    GstFastFlipSlice* slices;
+    GMutex lock;
+    GCond cond;
+    guint pending;
+};
+
+struct _GstFastFlipClass
+{
+    GstVideoFilterClass parent_class;
+};
+
+GType gst_fast_flip_get_type();
+
+/* Registers the fastflip element as a static plugin of this application */
+gboolean gst_fast_flip_register();
+
+G_END_DECLS
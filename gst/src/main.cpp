@@ -2,19 +2,63 @@
 #include <gst/video/video.h>
 #include <gst/app/gstappsrc.h>
 #include <gst/app/gstappsink.h>
+#include <gst/allocators/allocators.h>
+#include <benchcore/bench.h>
 
+#include <sys/mman.h>
+#include <errno.h>
+#include <unistd.h>
+#include <atomic>
 #include <stdio.h>
 #include <iostream>
 #include <string.h>
 #include <stdlib.h>
 #include <chrono>
-#include <cmath>
 
+#include "gstarenaallocator.h"
+#include "gstcosttracer.h"
+#include "gstfastflip.h"
 #include "values.h"
 
 GST_DEBUG_CATEGORY(appsrc_pipeline_debug);
 #define GST_CAT_DEFAULT appsrc_pipeline_debug
 
+typedef struct _FrameRing FrameRing;
+typedef struct _FrameSlot FrameSlot;
+
+typedef enum
+{
+    INGEST_NONE,
+    INGEST_COPY,
+    INGEST_WRAP,
+    INGEST_MEMFD,
+} Ingest;
+
+struct _FrameSlot
+{
+    FrameRing* ring;
+    guint index;
+};
+
+/* Stands in for the acquisition code's own ring of host frames, a slot is
+ * only reused after GStreamer released the buffer wrapping it */
+struct _FrameRing
+{
+    guint8* data;
+    gsize frame_size;
+    guint n_slots;
+
+    gint fd;
+    GstAllocator* fd_allocator;
+    GstMemory* fd_memory;
+
+    GMutex lock;
+    GCond cond;
+    gboolean* in_use;
+    FrameSlot* slots;
+    guint next;
+};
+
 typedef struct _App App;
 
 struct _App
@@ -36,38 +80,352 @@ struct _App
     gint ms_int;
 
     GstBufferList* buffer;
+
+    /* geometry of the current run, see run_geometry() */
+    const BenchConfig* config;
+    BenchGeometry geometry;
+    gsize frame_size;
+
+    /* frames from GstBufferPools instead of fresh allocations, see setup() */
+    gboolean pool;
+    GstBufferPool* in_pool;
+    GstBufferPool* out_pool;
+    BenchRecorder* alloc;
+
+    /* a second pass with frames from a hugepage arena, see run_geometry() */
+    gchar* pages_name;
+    BenchPages pages;
+    gboolean populate;
+    gboolean arena_pass;
+    GstAllocator* allocator;
+
+    /* frames from a caller owned ring, see new_frame() */
+    gchar* ingest_name;
+    Ingest ingest;
+    FrameRing* ring;
+    std::atomic<guint64> ingest_frames;
+    std::atomic<guint64> ingest_copied;
+
+    /* frames from a raw stack on disk, see new_frame() and set_source_values() */
+    gchar* source_path;
+    gint readahead = 8;
+    BenchSource* source;
+    gint64 source_read_ns;
+
+    /* sustained streaming, see test_stream() */
+    gboolean stream;
+    gdouble duration;
+    gint64 frames;
+    GMutex feed_lock;
+    guint64 pushed, received;
+    gint64 stream_start, first_sample, last_sample;
+    guint throttled;
+    gint64 throttle_start, throttled_ns;
+
+    /* per frame tracing, see trace_probe() */
+    gboolean trace;
+    BenchTrace* tracer;
+    guint stage_appsrc, stage_flip, stage_appsink;
+    BenchRecorder* startup;
+
+    /* per element cost, see gst_cost_tracer_report() */
+    gboolean cost;
+    GstCostTracer* cost_tracer;
+
+    /* hardware counters, see bench_perf_report() */
+    gboolean perf;
+
+    /* the flip element, see flip_description() */
+    gchar* element;
+    gint flip_threads;
+
+    /* independent pipelines at once, see test_pipelines() */
+    gint pipelines;
+    gboolean queues;
+
+    /* CPU and NUMA placement, see pin_producer() and stream_status() */
+    gchar* producer_cpus_name;
+    gchar* stream_cpus_name;
+    GArray* producer_cpus;
+    GArray* stream_cpus;
+    gint mem_node = -1;
+    BenchTopology* topology;
+    GMutex placement_lock;
+    GHashTable* stream_placement;
+};
+
+typedef struct _Stream Stream;
+
+/* One of the concurrent pipelines, fed and drained by its own threads */
+struct _Stream
+{
+    App* app;
+    guint index;
+
+    GstElement* pipeline;
+    GstElement* appsrc;
+    GstElement* appsink;
+    GstBufferPool* pool;
+
+    GThread* feeder;
+    GThread* consumer;
+
+    guint frames;
+    guint received;
+    gint64 start, end;
+
+    /* set by the consumer once the pipeline posted an error */
+    GstBus* bus;
+    gint failed;
+
+    /* push time and latency per frame, indexed by the buffer offset */
+    gint64* pushed_at;
+    gint64* latency;
+};
+
+typedef struct _TraceProbe TraceProbe;
+
+struct _TraceProbe
+{
+    App* app;
+    guint stage;
 };
 
 App s_app;
 
+static const GOptionEntry entries[] = {
+    { "trace", 't', 0, G_OPTION_ARG_NONE, &s_app.trace, "Trace the latency of every frame per element", NULL },
+    { "cost", 0, 0, G_OPTION_ARG_NONE, &s_app.cost, "Trace the processing time per element, queue levels, allocations and buffer lifetimes", NULL },
+    { "perf", 0, 0, G_OPTION_ARG_NONE, &s_app.perf, "Count cycles, instructions, LLC and dTLB misses and context switches of every thread", NULL },
+    { "pages", 0, 0, G_OPTION_ARG_STRING, &s_app.pages_name, "Run again with every frame in an arena of these pages, compared with a 4K arena set up the same way and with the default allocation", "4k|thp|2m|1g" },
+    { "populate", 0, 0, G_OPTION_ARG_NONE, &s_app.populate, "Fault the whole arena in when it is created", NULL },
+    { "pool", 'p', 0, G_OPTION_ARG_NONE, &s_app.pool, "Reuse frames from buffer pools and keep the pipeline playing", NULL },
+    { "ingest", 'i', 0, G_OPTION_ARG_STRING, &s_app.ingest_name, "Feed frames from a caller owned ring by copying, wrapping or as memfd memory", "copy|wrap|memfd" },
+    { "source", 0, 0, G_OPTION_ARG_FILENAME, &s_app.source_path, "Feed the frames of a raw frame stack, mapped and wrapped without a copy", "FILE" },
+    { "readahead", 0, 0, G_OPTION_ARG_INT, &s_app.readahead, "Frames the kernel reads ahead of the source (default 8)", "N" },
+    { "stream", 's', 0, G_OPTION_ARG_NONE, &s_app.stream, "Stream continuously with need-data/enough-data backpressure", NULL },
+    { "duration", 'd', 0, G_OPTION_ARG_DOUBLE, &s_app.duration, "Stop streaming after SECONDS (default 10 without --frames)", "SECONDS" },
+    { "frames", 'f', 0, G_OPTION_ARG_INT64, &s_app.frames, "Stop streaming after N frames, frames per pipeline with --pipelines", "N" },
+    { "element", 'e', 0, G_OPTION_ARG_STRING, &s_app.element, "Flip element, videoflip (default) or the in place fastflip", "videoflip|fastflip" },
+    { "flip-threads", 0, 0, G_OPTION_ARG_INT, &s_app.flip_threads, "Threads fastflip splits every frame over", "N" },
+    { "pipelines", 'P', 0, G_OPTION_ARG_INT, &s_app.pipelines, "Run 1, 2, 4, ... up to N independent pipelines at once", "N" },
+    { "queues", 'q', 0, G_OPTION_ARG_NONE, &s_app.queues, "Put queues before and after videoflip with --pipelines", NULL },
+    { "producer-cpus", 0, 0, G_OPTION_ARG_STRING, &s_app.producer_cpus_name, "Pin the producer, with --pipelines the feeder of each pipeline in turn", "LIST" },
+    { "stream-cpus", 0, 0, G_OPTION_ARG_STRING, &s_app.stream_cpus_name, "Pin each element's streaming thread to the next of these CPUs", "LIST" },
+    { "mem-node", 0, 0, G_OPTION_ARG_INT, &s_app.mem_node, "Bind the frames and the memory of the pinned threads to a NUMA node", "NODE" },
+    { NULL }
+};
+
+static FrameRing*
+frame_ring_new(guint n_slots, gsize frame_size, gboolean memfd, gint node)
+{
+    FrameRing* ring = g_new0(FrameRing, 1);
+    gsize size = n_slots * frame_size;
+
+    ring->frame_size = frame_size;
+    ring->n_slots = n_slots;
+    ring->fd = -1;
+
+    if (memfd)
+    {
+        ring->fd = memfd_create("frames", MFD_CLOEXEC);
+        if (ring->fd < 0 || ftruncate(ring->fd, size) != 0)
+            g_error("failed to create memfd: %s", g_strerror(errno));
+
+        ring->data = (guint8*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+        if (ring->data == MAP_FAILED)
+            g_error("failed to map memfd: %s", g_strerror(errno));
+
+        /* every frame is a shared part of this one memory */
+        ring->fd_allocator = gst_fd_allocator_new();
+        ring->fd_memory = gst_fd_allocator_alloc(ring->fd_allocator, ring->fd, size, GST_FD_MEMORY_FLAG_DONT_CLOSE);
+    }
+    else
+    {
+        ring->data = (guint8*)g_malloc(size);
+    }
+
+    if (node >= 0 && !bench_bind_memory(ring->data, size, node))
+        g_warning("could not bind the ring to node %d: %s", node, g_strerror(errno));
+
+    /* the acquisition has written the frames before they are handed over */
+    memset(ring->data, 0, size);
+    memset(ring->data, 0xFF, frame_size / 2);
+
+    g_mutex_init(&ring->lock);
+    g_cond_init(&ring->cond);
+    ring->in_use = g_new0(gboolean, n_slots);
+    ring->slots = g_new(FrameSlot, n_slots);
+    for (guint i = 0; i < n_slots; i++)
+    {
+        ring->slots[i].ring = ring;
+        ring->slots[i].index = i;
+    }
+
+    return ring;
+}
+
+static void
+frame_ring_free(FrameRing* ring)
+{
+    if (ring->fd >= 0)
+    {
+        gst_memory_unref(ring->fd_memory);
+        gst_object_unref(ring->fd_allocator);
+        munmap(ring->data, ring->n_slots * ring->frame_size);
+        close(ring->fd);
+    }
+    else
+    {
+        g_free(ring->data);
+    }
+
+    g_free(ring->slots);
+    g_free(ring->in_use);
+    g_cond_clear(&ring->cond);
+    g_mutex_clear(&ring->lock);
+    g_free(ring);
+}
+
+/* Blocks like the acquisition would when all slots are still in flight */
+static FrameSlot*
+frame_ring_acquire(FrameRing* ring)
+{
+    g_mutex_lock(&ring->lock);
+    while (ring->in_use[ring->next])
+        g_cond_wait(&ring->cond, &ring->lock);
+
+    FrameSlot* slot = &ring->slots[ring->next];
+    ring->in_use[ring->next] = TRUE;
+    ring->next = (ring->next + 1) % ring->n_slots;
+    g_mutex_unlock(&ring->lock);
+
+    return slot;
+}
+
+static void
+frame_ring_release(FrameSlot* slot)
+{
+    FrameRing* ring = slot->ring;
+
+    g_mutex_lock(&ring->lock);
+    ring->in_use[slot->index] = FALSE;
+    g_cond_signal(&ring->cond);
+    g_mutex_unlock(&ring->lock);
+}
+
+static GQuark
+frame_slot_quark()
+{
+    static GQuark quark = g_quark_from_static_string("frame-slot");
+
+    return quark;
+}
+
+/* Next input frame, either the next one of the source, reused from the pool,
+ * taken from the ring or freshly allocated */
+static GstBuffer*
+new_frame(App* app)
+{
+    GstBuffer* buffer = NULL;
+
+    if (app->source != NULL)
+    {
+        /* the mapping outlives every pipeline, there is nothing to release.
+         * In place elements get a copy, the frame stays page cache */
+        const guint8* frame = bench_source_next(app->source, 1);
+
+        buffer = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, (gpointer)frame, app->frame_size,
+            0, app->frame_size, NULL, NULL);
+    }
+    else if (app->ring != NULL)
+    {
+        FrameRing* ring = app->ring;
+        FrameSlot* slot = frame_ring_acquire(ring);
+        guint8* frame = ring->data + slot->index * ring->frame_size;
+
+        switch (app->ingest)
+        {
+        case INGEST_COPY:
+            buffer = gst_buffer_new_allocate(app->allocator, ring->frame_size, NULL);
+            gst_buffer_fill(buffer, 0, frame, ring->frame_size);
+            frame_ring_release(slot);
+            break;
+        case INGEST_WRAP:
+            buffer = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, frame, ring->frame_size,
+                0, ring->frame_size, slot, (GDestroyNotify)frame_ring_release);
+            break;
+        case INGEST_MEMFD:
+            buffer = gst_buffer_new();
+            gst_buffer_append_memory(buffer, gst_memory_share(ring->fd_memory, slot->index * ring->frame_size, ring->frame_size));
+            /* released together with the buffer and thereby its memory */
+            gst_mini_object_set_qdata(GST_MINI_OBJECT(buffer), frame_slot_quark(), slot, (GDestroyNotify)frame_ring_release);
+            break;
+        default:
+            g_assert_not_reached();
+        }
+    }
+    else if (app->in_pool != NULL)
+    {
+        if (gst_buffer_pool_acquire_buffer(app->in_pool, &buffer, NULL) != GST_FLOW_OK)
+            g_error("failed to acquire buffer");
+    }
+    else
+    {
+        buffer = gst_buffer_new_allocate(app->allocator, app->frame_size, NULL);
+    }
+
+    return buffer;
+}
+
+/* Forget the feeding idle source unless a new one was added meanwhile */
+static void
+clear_feed_source(App* app)
+{
+    g_mutex_lock(&app->feed_lock);
+    if (app->sourceid == g_source_get_id(g_main_current_source()))
+        app->sourceid = 0;
+    g_mutex_unlock(&app->feed_lock);
+}
+
+/* Idle handler that pushes one fresh frame per call while appsrc wants data */
 static gboolean
 read_data(App* app)
 {
-    guint len;
     GstFlowReturn ret;
 
-    GST_DEBUG("feed buffer");
-    g_signal_emit_by_name(app->appsrc, "push-buffer-list", app->buffer, &ret);
-    //ret = gst_app_src_push_buffer_list(GST_APP_SRC(app->appsrc), app->buffer);
-    
-    if (ret != GST_FLOW_OK)
+    if ((app->frames > 0 && app->pushed >= (guint64)app->frames) ||
+        (app->duration > 0 && bench_now_ns() - app->stream_start >= app->duration * 1e9))
     {
-        /* some error, stop sending data */
-        GST_DEBUG("failed to push buffers %d", ret);
+        /* signal eos */
+        ret = gst_app_src_end_of_stream(GST_APP_SRC(app->appsrc));
+        app->eos = TRUE;
+
+        if (ret != GST_FLOW_OK)
+        {
+            // some error, stop sending data
+            GST_DEBUG("failed to set eos %d", ret);
+        }
+
+        clear_feed_source(app);
         return FALSE;
     }
 
-    /* signal eos */
-    ret = gst_app_src_end_of_stream(GST_APP_SRC(app->appsrc));
-    app->eos = TRUE;
+    GstBuffer* buffer = new_frame(app);
+    GST_BUFFER_OFFSET(buffer) = app->pushed++;
+
+    GST_DEBUG("feed buffer");
+    ret = gst_app_src_push_buffer(GST_APP_SRC(app->appsrc), buffer);
 
     if (ret != GST_FLOW_OK)
     {
-        // some error, stop sending data
-        GST_DEBUG("failed to set eos %d", ret);
+        /* some error, stop sending data */
+        GST_DEBUG("failed to push buffer %d", ret);
+        clear_feed_source(app);
+        return FALSE;
     }
 
-    return FALSE;
+    return TRUE;
 }
 
 /* This signal callback is called when appsrc needs data, we add an idle handler
@@ -75,11 +433,19 @@ read_data(App* app)
 static void
 start_feed(GstElement* pipeline, guint size, App* app)
 {
-    if (!app->eos)
+    g_mutex_lock(&app->feed_lock);
+    if (!app->eos && app->sourceid == 0)
     {
         GST_DEBUG("start feeding");
         app->sourceid = g_idle_add((GSourceFunc)read_data, app);
+
+        if (app->throttle_start != 0)
+        {
+            app->throttled_ns += bench_now_ns() - app->throttle_start;
+            app->throttle_start = 0;
+        }
     }
+    g_mutex_unlock(&app->feed_lock);
 }
 
 /* This callback is called when appsrc has enough data and we can stop sending.
@@ -87,13 +453,17 @@ start_feed(GstElement* pipeline, guint size, App* app)
 static void
 stop_feed(GstElement* pipeline, App* app)
 {
-    GstFlowReturn ret;
+    g_mutex_lock(&app->feed_lock);
     if (app->sourceid != 0)
     {
         GST_DEBUG("stop feeding");
         g_source_remove(app->sourceid);
         app->sourceid = 0;
+
+        app->throttled++;
+        app->throttle_start = bench_now_ns();
     }
+    g_mutex_unlock(&app->feed_lock);
 }
 
 static void
@@ -107,7 +477,7 @@ stop(GstElement* appsink, App* app)
     g_main_loop_quit(app->loop);
 }
 
-static void
+static GstFlowReturn
 new_sample(GstElement* appsink, App* app)
 {
     GST_DEBUG("new sample");
@@ -116,12 +486,18 @@ new_sample(GstElement* appsink, App* app)
     //sample = gst_app_sink_pull_sample(GST_APP_SINK(appsink));
     g_signal_emit_by_name(appsink, "pull-sample", &sample, NULL);
 
-    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    gint64 now = bench_now_ns();
+    if (app->received == 0)
+        app->first_sample = now;
+    app->last_sample = now;
+    app->received++;
+
+    //GstBuffer* buffer = gst_sample_get_buffer(sample);
     //gst_buffer_extract(buffer, 0, app->data, HEIGHT * WIDTH * 4);
 
     gst_sample_unref(sample);
 
-    return;
+    return GST_FLOW_OK;
 
     /*FILE* pFile;
     pFile = fopen(fmt::format("{}", app->count++).c_str(), "wb");
@@ -159,6 +535,180 @@ bus_message(GstBus* bus, GstMessage* message, App* app)
     return TRUE;
 }
 
+/* Stamps every buffer passing the pad, the frame index is carried in the
+ * buffer offset which videoflip copies to its output buffers */
+static GstPadProbeReturn
+trace_probe(GstPad* pad, GstPadProbeInfo* info, TraceProbe* probe)
+{
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST)
+    {
+        GstBufferList* list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+        guint len = gst_buffer_list_length(list);
+
+        for (guint i = 0; i < len; i++)
+        {
+            bench_trace_stamp(probe->app->tracer, probe->stage, GST_BUFFER_OFFSET(gst_buffer_list_get(list, i)));
+        }
+    }
+    else
+    {
+        bench_trace_stamp(probe->app->tracer, probe->stage, GST_BUFFER_OFFSET(GST_PAD_PROBE_INFO_BUFFER(info)));
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+static void
+add_trace_probe(App* app, const gchar* name, guint stage)
+{
+    GstElement* element = gst_bin_get_by_name(GST_BIN(app->pipeline), name);
+    g_assert(element);
+    GstPad* pad = gst_element_get_static_pad(element, "src");
+    g_assert(pad);
+
+    TraceProbe* probe = g_new(TraceProbe, 1);
+    probe->app = app;
+    probe->stage = stage;
+
+    gst_pad_add_probe(pad, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST),
+        (GstPadProbeCallback)trace_probe, probe, g_free);
+
+    gst_object_unref(pad);
+    gst_object_unref(element);
+}
+
+/* Offer the output pool to videoflip, so the buffers return to it as soon as
+ * the appsink sample is unreffed */
+static GstPadProbeReturn
+allocation_probe(GstPad* pad, GstPadProbeInfo* info, App* app)
+{
+    GstQuery* query = GST_PAD_PROBE_INFO_QUERY(info);
+
+    if (GST_QUERY_TYPE(query) == GST_QUERY_ALLOCATION)
+    {
+        gst_query_add_allocation_pool(query, app->out_pool, app->frame_size, app->geometry.number, 0);
+        gst_query_add_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+static GstBufferPool*
+create_pool(App* app, GstCaps* caps)
+{
+    GstBufferPool* pool = gst_video_buffer_pool_new();
+    GstStructure* config = gst_buffer_pool_get_config(pool);
+
+    /* preallocate a whole batch, grow if the stream mode needs more */
+    gst_buffer_pool_config_set_params(config, caps, app->frame_size, app->geometry.number, 0);
+    if (app->allocator != NULL)
+        gst_buffer_pool_config_set_allocator(config, app->allocator, NULL);
+    if (!gst_buffer_pool_set_config(pool, config))
+        g_error("failed to configure buffer pool");
+
+    return pool;
+}
+
+/* Proves the zero copy ingest, every byte videoflip reads that is not backed
+ * by the ring has been copied on the way */
+static GstPadProbeReturn
+ingest_probe(GstPad* pad, GstPadProbeInfo* info, App* app)
+{
+    FrameRing* ring = app->ring;
+    GstBufferList* list = NULL;
+    GstBuffer* single = NULL;
+    guint len = 1;
+
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST)
+    {
+        list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+        len = gst_buffer_list_length(list);
+    }
+    else
+    {
+        single = GST_PAD_PROBE_INFO_BUFFER(info);
+    }
+
+    for (guint i = 0; i < len; i++)
+    {
+        GstBuffer* buffer = list != NULL ? gst_buffer_list_get(list, i) : single;
+        guint n = gst_buffer_n_memory(buffer);
+
+        for (guint j = 0; j < n; j++)
+        {
+            GstMemory* mem = gst_buffer_peek_memory(buffer, j);
+            gboolean in_ring;
+
+            if (ring->fd >= 0)
+            {
+                in_ring = gst_is_fd_memory(mem) && gst_fd_memory_get_fd(mem) == ring->fd;
+            }
+            else
+            {
+                GstMapInfo map;
+
+                gst_memory_map(mem, &map, GST_MAP_READ);
+                in_ring = map.data >= ring->data && map.data < ring->data + ring->n_slots * ring->frame_size;
+                gst_memory_unmap(mem, &map);
+            }
+
+            if (!in_ring)
+                app->ingest_copied += mem->size;
+        }
+    }
+
+    app->ingest_frames += len;
+
+    return GST_PAD_PROBE_OK;
+}
+
+/* There is no single channel float format videoflip handles, FLOAT32 frames
+ * are flipped as RGBA which moves the same 4 byte pixels */
+static GstVideoFormat
+video_format(BenchFormat format)
+{
+    switch (format)
+    {
+    case BENCH_FORMAT_GRAY8:
+        return GST_VIDEO_FORMAT_GRAY8;
+    case BENCH_FORMAT_GRAY16:
+        return GST_VIDEO_FORMAT_GRAY16_LE;
+    default:
+        return GST_VIDEO_FORMAT_RGBA;
+    }
+}
+
+static gboolean
+is_fastflip(App* app)
+{
+    return g_strcmp0(app->element, "fastflip") == 0;
+}
+
+/* The flip element as it goes into gst_parse_launch() */
+static gchar*
+flip_description(App* app, const gchar* name)
+{
+    if (is_fastflip(app))
+        return g_strdup_printf("fastflip name=%s threads=%d", name, MAX(app->flip_threads, 1));
+
+    return g_strdup_printf("videoflip name=%s method=horizontal-flip", name);
+}
+
+/* Name of a report entry, tagged with the geometry in a sweep */
+static gchar*
+metric_name(App* app, const gchar* name)
+{
+    if (!app->arena_pass)
+        return bench_config_get_metric_name(app->config, name, &app->geometry);
+
+    /* the default pass keeps the plain names, baselines stay comparable */
+    gchar* arena = g_strdup_printf("%s %s", name, bench_pages_to_string(app->pages));
+    gchar* full = bench_config_get_metric_name(app->config, arena, &app->geometry);
+    g_free(arena);
+
+    return full;
+}
+
 static void
 check_error(GError** error)
 {
@@ -169,6 +719,110 @@ check_error(GError** error)
     }
 }
 
+/* Pins the calling producer thread, index picks its CPU from the list */
+static void
+pin_producer(App* app, guint index)
+{
+    if (app->producer_cpus != NULL)
+    {
+        gint cpu = g_array_index(app->producer_cpus, gint, index % app->producer_cpus->len);
+
+        if (!bench_pin_thread(cpu))
+            g_warning("could not pin producer %u to cpu %d: %s", index, cpu, g_strerror(errno));
+    }
+
+    if (app->mem_node >= 0 && !bench_bind_thread_memory(app->mem_node))
+        g_warning("could not bind producer %u to node %d: %s", index, app->mem_node, g_strerror(errno));
+}
+
+/* New threads inherit the pinned producer's affinity, they get every CPU
+ * back until stream_status() or pin_producer() places them */
+static void
+release_thread(gpointer user_data)
+{
+    App* app = (App*)user_data;
+
+    bench_pin_thread_cpus(app->topology->cpus, app->topology->n_cpus);
+}
+
+/* Called by every streaming thread itself as it enters its loop. An element
+ * keeps its CPU when its task restarts */
+static GstBusSyncReply
+stream_status(GstBus* bus, GstMessage* message, App* app)
+{
+    GstStreamStatusType type;
+    GstElement* owner;
+
+    (void)bus;
+
+    if (GST_MESSAGE_TYPE(message) != GST_MESSAGE_STREAM_STATUS)
+        return GST_BUS_PASS;
+
+    gst_message_parse_stream_status(message, &type, &owner);
+    if (type != GST_STREAM_STATUS_TYPE_ENTER)
+        return GST_BUS_PASS;
+
+    if (app->stream_cpus != NULL)
+    {
+        GstObject* parent = gst_object_get_parent(GST_OBJECT(owner));
+        gchar* key = g_strdup_printf("%s/%s", parent != NULL ? GST_OBJECT_NAME(parent) : "", GST_OBJECT_NAME(owner));
+        guint n = app->stream_cpus->len;
+
+        g_mutex_lock(&app->placement_lock);
+        gpointer value = g_hash_table_lookup(app->stream_placement, key);
+        if (value == NULL)
+        {
+            value = GINT_TO_POINTER(g_array_index(app->stream_cpus, gint, g_hash_table_size(app->stream_placement) % n) + 1);
+            g_hash_table_insert(app->stream_placement, key, value);
+        }
+        else
+            g_free(key);
+        g_mutex_unlock(&app->placement_lock);
+
+        gint cpu = GPOINTER_TO_INT(value) - 1;
+        if (!bench_pin_thread(cpu))
+            g_warning("could not pin the streaming thread of %s to cpu %d", GST_OBJECT_NAME(owner), cpu);
+
+        if (parent != NULL)
+            gst_object_unref(parent);
+    }
+
+    if (app->mem_node >= 0)
+        bench_bind_thread_memory(app->mem_node);
+
+    return GST_BUS_PASS;
+}
+
+static void
+watch_stream_status(App* app, GstElement* pipeline)
+{
+    if (app->stream_cpus == NULL && app->mem_node < 0)
+        return;
+
+    GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
+    gst_bus_set_sync_handler(bus, (GstBusSyncHandler)stream_status, app, NULL);
+    gst_object_unref(bus);
+}
+
+/* "pipeline0/mysource:2 ...", sorted by element name */
+static gchar*
+stream_placement_to_string(App* app)
+{
+    GString* placement = g_string_new(NULL);
+    GList* keys = g_list_sort(g_hash_table_get_keys(app->stream_placement), (GCompareFunc)g_strcmp0);
+
+    for (GList* key = keys; key != NULL; key = key->next)
+    {
+        gint cpu = GPOINTER_TO_INT(g_hash_table_lookup(app->stream_placement, key->data)) - 1;
+
+        g_string_append_printf(placement, "%s%s:%d", placement->len > 0 ? " " : "", (const gchar*)key->data, cpu);
+    }
+
+    g_list_free(keys);
+
+    return g_string_free(placement, FALSE);
+}
+
 void setup()
 {
     App* app = &s_app;
@@ -176,30 +830,78 @@ void setup()
     GstCaps* caps;
     GstVideoInfo info;
 
-    app->pipeline = gst_parse_launch("appsrc name=mysource ! videoflip method=horizontal-flip ! appsink name=mysink", &error);
+    gchar* flip = flip_description(app, "myflip");
+    gchar* description = g_strdup_printf("appsrc name=mysource ! %s ! appsink name=mysink", flip);
+    app->pipeline = gst_parse_launch(description, &error);
+    g_free(description);
+    g_free(flip);
     check_error(&error);
     g_assert(app->pipeline);
+    watch_stream_status(app, app->pipeline);
 
     /* get the appsrc */
     app->appsrc = gst_bin_get_by_name(GST_BIN(app->pipeline), "mysource");
     g_assert(app->appsrc);
 
     /* set the caps on the source */
-    gst_video_info_set_format(&info, GST_VIDEO_FORMAT_RGBA, WIDTH, HEIGHT);
+    gst_video_info_set_format(&info, video_format(app->geometry.format), app->geometry.width, app->geometry.height);
     caps = gst_video_info_to_caps(&info);
     g_object_set(app->appsrc,
                 "caps", caps,
                 "format", GST_FORMAT_TIME,
-                "max-buffers", NUMBER,
-                "max-bytes", NUMBER * WIDTH * HEIGHT * 4, NULL);
+                "max-buffers", (guint64)app->geometry.number,
+                "max-bytes", (guint64)bench_geometry_batch_size(&app->geometry), NULL);
 
     app->appsink = gst_bin_get_by_name(GST_BIN(app->pipeline), "mysink");
     g_assert(app->appsink);
     g_object_set(app->appsink,
-                "max-buffers", NUMBER,
+                "max-buffers", app->geometry.number,
                 "async", false, NULL);
 
-    app->data = g_malloc(WIDTH * HEIGHT * 4);
+    app->data = g_malloc(app->frame_size);
+
+    if (app->pool)
+    {
+        app->in_pool = create_pool(app, caps);
+        gst_buffer_pool_set_active(app->in_pool, TRUE);
+
+        /* configured and activated by videoflip once it accepts it */
+        app->out_pool = create_pool(app, caps);
+        GstPad* pad = gst_element_get_static_pad(app->appsink, "sink");
+        /* query probes fire again when the answer returns, only the way in
+         * adds the pool */
+        gst_pad_add_probe(pad, (GstPadProbeType)(GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM | GST_PAD_PROBE_TYPE_PUSH),
+            (GstPadProbeCallback)allocation_probe, app, NULL);
+        gst_object_unref(pad);
+    }
+    gst_caps_unref(caps);
+
+    if (app->ingest != INGEST_NONE)
+    {
+        app->ring = frame_ring_new(app->geometry.number, app->frame_size, app->ingest == INGEST_MEMFD, app->mem_node);
+
+        GstElement* flip = gst_bin_get_by_name(GST_BIN(app->pipeline), "myflip");
+        GstPad* pad = gst_element_get_static_pad(flip, "sink");
+        gst_pad_add_probe(pad, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST),
+            (GstPadProbeCallback)ingest_probe, app, NULL);
+        gst_object_unref(pad);
+        gst_object_unref(flip);
+    }
+
+    if (app->stream)
+    {
+        g_signal_connect(app->appsrc, "need-data", G_CALLBACK(start_feed), app);
+        g_signal_connect(app->appsrc, "enough-data", G_CALLBACK(stop_feed), app);
+
+        g_object_set(app->appsink, "emit-signals", TRUE, NULL);
+        g_signal_connect(app->appsink, "new-sample", G_CALLBACK(new_sample), app);
+    }
+
+    if (app->trace)
+    {
+        add_trace_probe(app, "mysource", app->stage_appsrc);
+        add_trace_probe(app, "myflip", app->stage_flip);
+    }
 }
 
 void cleanup()
@@ -212,100 +914,904 @@ void cleanup()
         GstBuffer* buffer = gst_buffer_list_get(app->buffer, i);
         gst_buffer_unref(buffer);
     }*/
-    gst_buffer_list_unref(app->buffer);
+    if (app->buffer != NULL)
+        gst_buffer_list_unref(app->buffer);
     //gst_object_unref(app->bus);
     //g_main_loop_unref(app->loop);
     gst_object_unref(GST_OBJECT(app->appsrc));
     gst_object_unref(GST_OBJECT(app->appsink));
     gst_object_unref(GST_OBJECT(app->pipeline));
+
+    if (app->in_pool != NULL)
+    {
+        gst_buffer_pool_set_active(app->in_pool, FALSE);
+        gst_object_unref(app->in_pool);
+    }
+    if (app->out_pool != NULL)
+        gst_object_unref(app->out_pool);
+    if (app->ring != NULL)
+        frame_ring_free(app->ring);
+
+    app->buffer = NULL;
+    app->in_pool = NULL;
+    app->out_pool = NULL;
+    app->ring = NULL;
 }
 
-gint test()
+gint64 test(gpointer user_data)
 {
+    (void)user_data;
+
     App* app = &s_app;
 
-    app->buffer = gst_buffer_list_new_sized(NUMBER);
+    gint64 t0 = bench_now_ns();
+
+    app->buffer = gst_buffer_list_new_sized(app->geometry.number);
 
     gst_buffer_list_make_writable(app->buffer);
-    for (guint i = 0; i < NUMBER; i++)
+    for (guint i = 0; i < app->geometry.number; i++)
     {
-        GstBuffer* buffer = gst_buffer_new_allocate(NULL, HEIGHT * WIDTH * 4, NULL);
+        GstBuffer* buffer = new_frame(app);
+        GST_BUFFER_OFFSET(buffer) = i;
 
-        if (i == 0)
+        if (i == 0 && app->ring == NULL && app->source == NULL)
         {
-            gst_buffer_memset(buffer, 0, 0xFF, HEIGHT * WIDTH * 2);
+            gst_buffer_memset(buffer, 0, 0xFF, app->frame_size / 2);
         }
         gst_buffer_list_add(app->buffer, buffer);
     }
     
-    auto t1 = std::chrono::high_resolution_clock::now();
+    gint64 t1 = bench_now_ns();
 
-    /* go to playing and wait in a mainloop. */
-    gst_element_set_state(app->pipeline, GST_STATE_PLAYING);
+    bench_recorder_add(app->alloc, t1 - t0);
 
-    GstFlowReturn ret;
-    ret = gst_app_src_push_buffer_list(GST_APP_SRC(app->appsrc), app->buffer);
+    /* go to playing and wait in a mainloop. Pooled runs stay playing, going
+     * to NULL would deactivate videoflip's output pool and free its buffers */
+    if (!app->pool)
+        gst_element_set_state(app->pipeline, GST_STATE_PLAYING);
+
+    GstFlowReturn ret = GST_FLOW_OK;
+    if (is_fastflip(app))
+    {
+        /* buffers of a list are shared with the list while they are pushed,
+         * so an in place element would have to copy them first */
+        guint n = gst_buffer_list_length(app->buffer);
+        GstBuffer** buffers = g_new(GstBuffer*, n);
+
+        for (guint i = 0; i < n; i++)
+            buffers[i] = gst_buffer_ref(gst_buffer_list_get(app->buffer, i));
+        gst_buffer_list_unref(app->buffer);
+
+        for (guint i = 0; i < n; i++)
+        {
+            if (ret == GST_FLOW_OK)
+                ret = gst_app_src_push_buffer(GST_APP_SRC(app->appsrc), buffers[i]);
+            else
+                gst_buffer_unref(buffers[i]);
+        }
+        g_free(buffers);
+    }
+    else
+    {
+        ret = gst_app_src_push_buffer_list(GST_APP_SRC(app->appsrc), app->buffer);
+    }
+    /* appsrc took ownership of the list */
+    app->buffer = NULL;
 
     if (ret != GST_FLOW_OK)
     {
         GST_DEBUG("failed to push buffers %d", ret);
     }
 
-    for (gint i = 0; i < NUMBER; i++)
+    for (guint i = 0; i < app->geometry.number; i++)
     {
         GstSample* sample = gst_app_sink_pull_sample(GST_APP_SINK(app->appsink));
         g_assert(sample);
+
+        if (app->trace)
+        {
+            bench_trace_stamp(app->tracer, app->stage_appsink, GST_BUFFER_OFFSET(gst_sample_get_buffer(sample)));
+
+            /* time until the first frame is out, kept apart from the steady state */
+            if (i == 0)
+                bench_recorder_add(app->startup, bench_now_ns() - t1);
+        }
+
         gst_sample_unref(sample);
     }
 
-    auto t2 = std::chrono::high_resolution_clock::now();
+    gint64 t2 = bench_now_ns();
+
+    GST_DEBUG("stopping");
+
+    if (!app->pool)
+    {
+        gst_element_set_state(app->pipeline, GST_STATE_NULL);
+        gst_element_set_state(app->pipeline, GST_STATE_READY);
+    }
+
+    /* all streaming threads are stopped now, or idle with appsrc drained */
+    if (app->trace)
+        bench_trace_collect(app->tracer, app->geometry.number);
+
+    return t2 - t1;
+}
+
+static void
+set_value(App* app, BenchReport* report, const gchar* name, gdouble value, const gchar* unit)
+{
+    gchar* full = metric_name(app, name);
+
+    bench_report_set_value(report, full, value, unit);
+    g_free(full);
+}
+
+/* Bytes are what the flip reads plus writes */
+static void
+set_bandwidth(App* app, BenchReport* report, const gchar* name, gdouble bytes, gdouble ns)
+{
+    gchar* full = metric_name(app, name);
+
+    bench_report_set_bandwidth(report, full, bytes, ns);
+    g_free(full);
+}
+
+/* The disk delivers frames at the rate of the cold read, the pipeline
+ * processes them at fps from the page cache, the lower of both is what real
+ * data gets through */
+static void
+set_source_values(App* app, BenchReport* report, gdouble fps)
+{
+    gdouble disk = app->source_read_ns > 0 ? app->source->size / (app->source_read_ns / 1e9) / app->frame_size : 0;
+
+    set_value(app, report, "Disk Rate", disk, "frames/s");
+    set_value(app, report, "Compute Rate", fps, "frames/s");
+    set_value(app, report, "Real Data Rate", MIN(disk, fps), "frames/s");
+    if (bench_config_get_n_geometries(app->config) == 1)
+        bench_report_set_info(report, "bound", disk < fps ? "disk" : "compute");
+}
+
+/* Runs the pipeline until the duration or frame count is reached, the main loop
+ * is the producer and refills appsrc from an idle handler between need-data
+ * and enough-data */
+void test_stream(BenchReport* report)
+{
+    App* app = &s_app;
+
+    app->loop = g_main_loop_new(NULL, FALSE);
+    app->bus = gst_pipeline_get_bus(GST_PIPELINE(app->pipeline));
+    guint watch = gst_bus_add_watch(app->bus, (GstBusFunc)bus_message, app);
+
+    /* the whole stream is one iteration */
+    if (app->config->perf != NULL)
+        bench_perf_begin(app->config->perf);
+
+    app->stream_start = bench_now_ns();
+    gst_element_set_state(app->pipeline, GST_STATE_PLAYING);
+
+    g_main_loop_run(app->loop);
+
+    gint64 end = bench_now_ns();
+
+    if (app->config->perf != NULL)
+        bench_perf_end(app->config->perf);
 
     GST_DEBUG("stopping");
 
     gst_element_set_state(app->pipeline, GST_STATE_NULL);
-    gst_element_set_state(app->pipeline, GST_STATE_READY);
 
-    return std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+    if (app->throttle_start != 0)
+        app->throttled_ns += end - app->throttle_start;
+
+    g_source_remove(watch);
+    gst_object_unref(app->bus);
+    g_main_loop_unref(app->loop);
+
+    gdouble frame_bytes = app->frame_size;
+    gdouble total = (end - app->stream_start) / 1e9;
+    /* first to last frame, so pipeline startup does not count */
+    gdouble sustained = app->received > 1 ? (app->last_sample - app->first_sample) / 1e9 : 0;
+    gdouble fps = sustained > 0 ? (app->received - 1) / sustained : 0;
+
+    set_value(app, report, "Frames", app->received, "frames");
+    set_value(app, report, "Duration", total, "s");
+    /* first_sample is only known once a sample arrived */
+    if (app->received > 0)
+        set_value(app, report, "Startup", (app->first_sample - app->stream_start) / 1e6, "ms");
+    set_value(app, report, "Sustained", fps, "frames/s");
+    set_bandwidth(app, report, "Sustained Bandwidth", 2 * frame_bytes * fps, 1e9);
+    set_value(app, report, "Throttled", app->throttled, "times");
+    set_value(app, report, "Throttled Time", total > 0 ? 100 * app->throttled_ns / 1e9 / total : 0, "%");
+    if (app->source != NULL)
+        set_source_values(app, report, fps);
+
+    if (app->config->perf != NULL)
+    {
+        gchar* name = metric_name(app, "stream");
+
+        bench_perf_report(app->config->perf, report, name, 2 * frame_bytes * app->received);
+        g_free(name);
+    }
+}
+
+/* Pushes the frames of one stream as fast as appsrc accepts them, appsrc
+ * blocks once it queued max-buffers */
+static gpointer
+feed_stream(gpointer user_data)
+{
+    Stream* stream = (Stream*)user_data;
+
+    pin_producer(stream->app, stream->index);
+
+    stream->start = bench_now_ns();
+
+    for (guint i = 0; i < stream->frames && !g_atomic_int_get(&stream->failed); i++)
+    {
+        GstBuffer* buffer = NULL;
+
+        if (gst_buffer_pool_acquire_buffer(stream->pool, &buffer, NULL) != GST_FLOW_OK)
+        {
+            GST_DEBUG("stream %u failed to acquire a buffer", stream->index);
+            break;
+        }
+
+        GST_BUFFER_OFFSET(buffer) = i;
+        stream->pushed_at[i] = bench_now_ns();
+        if (gst_app_src_push_buffer(GST_APP_SRC(stream->appsrc), buffer) != GST_FLOW_OK)
+        {
+            GST_DEBUG("stream %u failed to push buffer %u", stream->index, i);
+            break;
+        }
+    }
+
+    gst_app_src_end_of_stream(GST_APP_SRC(stream->appsrc));
+
+    return NULL;
+}
+
+/* An error of any element leaves appsink waiting forever, so the bus is
+ * polled between samples. The pool and appsrc are flushed on an error, which
+ * wakes up a feeder blocked in either. EOS only means the sink has seen it,
+ * appsink may still hold samples. Returns FALSE on an error */
+static gboolean
+stream_check_bus(Stream* stream)
+{
+    GstMessage* message = gst_bus_pop_filtered(stream->bus, (GstMessageType)(GST_MESSAGE_ERROR | GST_MESSAGE_EOS));
+    gboolean ok = TRUE;
+
+    if (message == NULL)
+        return TRUE;
+
+    if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR)
+    {
+        GError* err = NULL;
+        gchar* dbg_info = NULL;
+
+        gst_message_parse_error(message, &err, &dbg_info);
+        g_printerr("ERROR from element %s in stream %u: %s\n", GST_OBJECT_NAME(message->src), stream->index, err->message);
+        g_printerr("Debugging info: %s\n", (dbg_info) ? dbg_info : "none");
+        g_error_free(err);
+        g_free(dbg_info);
+
+        g_atomic_int_set(&stream->failed, TRUE);
+        gst_buffer_pool_set_flushing(stream->pool, TRUE);
+        gst_element_set_state(stream->appsrc, GST_STATE_NULL);
+        ok = FALSE;
+    }
+    gst_message_unref(message);
+
+    return ok;
+}
+
+static gpointer
+drain_stream(gpointer user_data)
+{
+    Stream* stream = (Stream*)user_data;
+    GstSample* sample;
+
+    while (TRUE)
+    {
+        sample = gst_app_sink_try_pull_sample(GST_APP_SINK(stream->appsink), 100 * GST_MSECOND);
+        if (sample == NULL)
+        {
+            if (gst_app_sink_is_eos(GST_APP_SINK(stream->appsink)) || !stream_check_bus(stream))
+                break;
+            continue;
+        }
+
+        gint64 now = bench_now_ns();
+        guint64 offset = GST_BUFFER_OFFSET(gst_sample_get_buffer(sample));
+
+        if (offset < stream->frames)
+            stream->latency[stream->received++] = now - stream->pushed_at[offset];
+        stream->end = now;
+        gst_sample_unref(sample);
+    }
+
+    return NULL;
+}
+
+static Stream*
+stream_new(App* app, guint index, guint frames)
+{
+    Stream* stream = g_new0(Stream, 1);
+    GError* error = NULL;
+    GstVideoInfo info;
+
+    stream->app = app;
+    stream->index = index;
+    stream->frames = frames;
+    stream->pushed_at = g_new0(gint64, frames);
+    stream->latency = g_new0(gint64, frames);
+
+    gchar* flip = flip_description(app, "myflip");
+    gchar* description = g_strdup_printf(app->queues ?
+        "appsrc name=mysource ! queue ! %s ! queue ! appsink name=mysink" :
+        "appsrc name=mysource ! %s ! appsink name=mysink", flip);
+    stream->pipeline = gst_parse_launch(description, &error);
+    g_free(description);
+    g_free(flip);
+    check_error(&error);
+    watch_stream_status(app, stream->pipeline);
+
+    stream->appsrc = gst_bin_get_by_name(GST_BIN(stream->pipeline), "mysource");
+    stream->appsink = gst_bin_get_by_name(GST_BIN(stream->pipeline), "mysink");
+    g_assert(stream->appsrc && stream->appsink);
+    stream->bus = gst_pipeline_get_bus(GST_PIPELINE(stream->pipeline));
+
+    gst_video_info_set_format(&info, video_format(app->geometry.format), app->geometry.width, app->geometry.height);
+    GstCaps* caps = gst_video_info_to_caps(&info);
+
+    /* a few frames in flight per stream, not a whole batch */
+    g_object_set(stream->appsrc,
+                "caps", caps,
+                "format", GST_FORMAT_TIME,
+                "block", TRUE,
+                "max-buffers", (guint64)4, NULL);
+    g_object_set(stream->appsink,
+                "max-buffers", 4,
+                "sync", FALSE, NULL);
+
+    stream->pool = gst_video_buffer_pool_new();
+    GstStructure* config = gst_buffer_pool_get_config(stream->pool);
+    gst_buffer_pool_config_set_params(config, caps, app->frame_size, 4, 0);
+    if (!gst_buffer_pool_set_config(stream->pool, config))
+        g_error("failed to configure buffer pool");
+    gst_buffer_pool_set_active(stream->pool, TRUE);
+    gst_caps_unref(caps);
+
+    return stream;
+}
+
+static void
+stream_free(Stream* stream)
+{
+    gst_element_set_state(stream->pipeline, GST_STATE_NULL);
+    gst_buffer_pool_set_active(stream->pool, FALSE);
+    gst_object_unref(stream->pool);
+    gst_object_unref(stream->appsrc);
+    gst_object_unref(stream->appsink);
+    gst_object_unref(stream->bus);
+    gst_object_unref(stream->pipeline);
+    g_free(stream->pushed_at);
+    g_free(stream->latency);
+    g_free(stream);
+}
+
+/* Runs n_streams pipelines side by side, all fed at once, and reports their
+ * combined and per stream throughput plus the latency of every frame */
+static void
+run_streams(App* app, BenchReport* report, guint n_streams, guint frames)
+{
+    Stream** streams = g_new0(Stream*, n_streams);
+    gint64 start = G_MAXINT64, end = 0;
+    gdouble slowest = G_MAXDOUBLE, sum = 0, worst_p99 = 0;
+    guint64 received = 0;
+
+    for (guint i = 0; i < n_streams; i++)
+    {
+        streams[i] = stream_new(app, i, frames);
+        gst_element_set_state(streams[i]->pipeline, GST_STATE_PLAYING);
+    }
+
+    for (guint i = 0; i < n_streams; i++)
+    {
+        streams[i]->consumer = g_thread_new("consumer", drain_stream, streams[i]);
+        streams[i]->feeder = g_thread_new("feeder", feed_stream, streams[i]);
+    }
+
+    gchar* base = g_strdup_printf("latency %u", n_streams);
+    gchar* name = metric_name(app, base);
+    BenchRecorder* latency = bench_report_add_metric(report, name, n_streams * frames);
+    g_free(name);
+    g_free(base);
+
+    for (guint i = 0; i < n_streams; i++)
+    {
+        Stream* stream = streams[i];
+
+        g_thread_join(stream->feeder);
+        g_thread_join(stream->consumer);
+        if (g_atomic_int_get(&stream->failed))
+            g_error("stream %u failed", stream->index);
+
+        start = MIN(start, stream->start);
+        end = MAX(end, stream->end);
+        received += stream->received;
+
+        gdouble fps = stream->end > stream->start ? stream->received * 1e9 / (stream->end - stream->start) : 0;
+        slowest = MIN(slowest, fps);
+        sum += fps;
+
+        BenchRecorder* own = bench_recorder_new("stream", stream->received);
+        BenchStats stats;
+
+        for (guint f = 0; f < stream->received; f++)
+        {
+            bench_recorder_add(latency, stream->latency[f]);
+            bench_recorder_add(own, stream->latency[f]);
+        }
+        bench_recorder_compute_stats(own, &stats);
+        worst_p99 = MAX(worst_p99, stats.p99);
+        bench_recorder_free(own);
+
+        stream_free(stream);
+    }
+
+    gdouble seconds = end > start ? (end - start) / 1e9 : 0;
+    gdouble aggregate = seconds > 0 ? received / seconds : 0;
+    const gchar* values[] = { "Aggregate", "Aggregate Bandwidth", "Per Stream", "Slowest Stream", "Worst Stream P99" };
+    gchar* names[G_N_ELEMENTS(values)];
+
+    for (guint i = 0; i < G_N_ELEMENTS(values); i++)
+    {
+        gchar* value = g_strdup_printf("%s %u", values[i], n_streams);
+        names[i] = metric_name(app, value);
+        g_free(value);
+    }
+
+    bench_report_set_value(report, names[0], aggregate, "frames/s");
+    bench_report_set_bandwidth(report, names[1], 2.0 * app->frame_size * aggregate, 1e9);
+    bench_report_set_value(report, names[2], sum / n_streams, "frames/s");
+    bench_report_set_value(report, names[3], slowest, "frames/s");
+    bench_report_set_value(report, names[4], worst_p99 / 1e6, "ms");
+
+    for (guint i = 0; i < G_N_ELEMENTS(values); i++)
+        g_free(names[i]);
+    g_free(streams);
+}
+
+/* Scales the number of pipelines up to --pipelines */
+void test_pipelines(BenchReport* report)
+{
+    App* app = &s_app;
+    guint frames = app->frames > 0 ? (guint)app->frames : app->geometry.number;
+
+    for (gint n = 1;; n = MIN(2 * n, app->pipelines))
+    {
+        run_streams(app, report, n, frames);
+
+        if (n == app->pipelines)
+            break;
+    }
+}
+
+/* Builds the pipeline for one geometry, runs the selected mode and tears it
+ * down again */
+void run_geometry(const BenchConfig* config, BenchReport* report, const BenchGeometry* geometry)
+{
+    App* app = &s_app;
+    BenchRecorder* run = NULL;
+    gchar* name;
+
+    app->config = config;
+    app->geometry = *geometry;
+    app->frame_size = bench_geometry_frame_size(geometry);
+
+    app->eos = FALSE;
+    app->sourceid = 0;
+    app->pushed = app->received = 0;
+    app->throttled = 0;
+    app->throttle_start = app->throttled_ns = 0;
+    app->ingest_frames = 0;
+    app->ingest_copied = 0;
+
+    if (app->pipelines > 0)
+    {
+        test_pipelines(report);
+        return;
+    }
+
+    if (!app->stream)
+    {
+        name = metric_name(app, "alloc");
+        app->alloc = bench_report_add_metric(report, name, config->iterations);
+        g_free(name);
+        name = metric_name(app, "run");
+        run = bench_report_add_metric(report, name, config->iterations);
+        g_free(name);
+    }
+
+    if (app->trace)
+    {
+        gchar* label = bench_config_get_n_geometries(config) > 1 ? bench_geometry_to_string(geometry) : NULL;
+
+        app->tracer = bench_trace_new(3 * geometry->number);
+        app->stage_appsrc = bench_trace_add_stage(app->tracer, "appsrc");
+        app->stage_flip = bench_trace_add_stage(app->tracer, is_fastflip(app) ? "fastflip" : "videoflip");
+        app->stage_appsink = bench_trace_add_stage(app->tracer, "appsink");
+        bench_trace_add_metrics(app->tracer, report, label, config->iterations * geometry->number);
+        name = metric_name(app, "startup");
+        app->startup = bench_report_add_metric(report, name, config->iterations);
+        g_free(name);
+        g_free(label);
+    }
+
+    if (app->cost_tracer != NULL)
+        gst_cost_tracer_reset(app->cost_tracer);
+
+    /* room for the input and the output pool, or the inputs of an iteration
+     * plus whatever is still in flight */
+    if (app->arena_pass)
+    {
+        GError* error = NULL;
+
+        app->allocator = gst_arena_allocator_new(app->frame_size, 2 * geometry->number, app->pages, app->populate,
+            app->mem_node, &error);
+        check_error(&error);
+
+        BenchArena* arena = GST_ARENA_ALLOCATOR(app->allocator)->arena;
+        bench_report_set_info(report, "arena-pages", bench_pages_to_string(arena->pages));
+        set_value(app, report, "Arena Setup", arena->setup_ns / 1e6, "ms");
+    }
+
+    if (app->source != NULL)
+    {
+        GError* error = NULL;
+
+        bench_source_set_frame_size(app->source, app->frame_size, &error);
+        check_error(&error);
+    }
+
+    setup();
+
+    if (app->pool && !app->stream)
+        gst_element_set_state(app->pipeline, GST_STATE_PLAYING);
+
+    if (app->stream)
+        test_stream(report);
+    else
+    {
+        BenchStats stats;
+
+        bench_run(config, run, test, NULL);
+        bench_baseline_compare(config->baseline, report, run, geometry);
+        bench_recorder_compute_stats(run, &stats);
+        set_bandwidth(app, report, "Bandwidth", 2.0 * bench_geometry_batch_size(geometry), stats.p50);
+        if (app->source != NULL)
+            set_source_values(app, report, stats.p50 > 0 ? geometry->number * 1e9 / stats.p50 : 0);
+
+        /* the default pass ran before with the same geometry, and unless the
+         * arena is on 4K a 4K arena set up the same way. Against that one the
+         * page size is the only difference, against the default reuse and
+         * prefaulting count as well */
+        if (app->arena_pass)
+        {
+            gchar* plain = bench_config_get_metric_name(config, "run", geometry);
+            BenchRecorder* default_run = bench_report_get_metric(report, plain);
+            BenchStats default_stats;
+
+            bench_recorder_compute_stats(default_run, &default_stats);
+            set_value(app, report, "Arena vs Default", stats.p50 > 0 ? default_stats.p50 / stats.p50 : 0, "x");
+            g_free(plain);
+
+            if (app->pages != BENCH_PAGES_4K)
+            {
+                gchar* small_base = g_strdup_printf("run %s", bench_pages_to_string(BENCH_PAGES_4K));
+                gchar* small = bench_config_get_metric_name(config, small_base, geometry);
+                BenchStats small_stats;
+
+                bench_recorder_compute_stats(bench_report_get_metric(report, small), &small_stats);
+                set_value(app, report, "Arena Speedup", stats.p50 > 0 ? small_stats.p50 / stats.p50 : 0, "x");
+                g_free(small);
+                g_free(small_base);
+            }
+        }
+
+        if (config->perf != NULL)
+            bench_perf_report(config->perf, report, run->name, 2.0 * bench_geometry_batch_size(geometry));
+    }
+
+    if (app->pool && !app->stream)
+        gst_element_set_state(app->pipeline, GST_STATE_NULL);
+
+    /* before cleanup(), the tracer names the elements it saw */
+    if (app->cost_tracer != NULL)
+    {
+        guint64 frames = app->stream ? app->received : (guint64)config->iterations * geometry->number;
+
+        gst_cost_tracer_report(app->cost_tracer, report, config, geometry, frames);
+    }
+
+    cleanup();
+
+    /* the last buffers went with the pipeline */
+    if (app->allocator != NULL)
+    {
+        set_value(app, report, "Arena Fallbacks", GST_ARENA_ALLOCATOR(app->allocator)->fallbacks, "allocations");
+        gst_object_unref(app->allocator);
+        app->allocator = NULL;
+    }
+
+    if (app->ingest != INGEST_NONE)
+    {
+        guint64 frames = app->ingest_frames;
+
+        set_value(app, report, "Copied per Frame", frames > 0 ? (gdouble)app->ingest_copied / frames : 0, "bytes");
+    }
+
+    if (app->tracer != NULL)
+    {
+        bench_trace_free(app->tracer);
+        app->tracer = NULL;
+    }
 }
 
 int
 main(int argc, char* argv[])
 {
+    BenchConfig config;
+    GError* error = NULL;
+
     gst_init(&argc, &argv);
 
     GST_DEBUG_CATEGORY_INIT(appsrc_pipeline_debug, "appsrc-pipeline", 0,
         "appsrc pipeline example");
-    
-    setup();
 
-    gint count = 3600;
-    glong sum = 0;
+    gst_fast_flip_register();
 
-    gint* values = new gint[count];
-    gint max = 0;
-    for (gint i = 0; i < count; i++)
+    bench_config_init(&config, WIDTH, HEIGHT, NUMBER, BENCH_FORMAT_RGBA);
+    if (!bench_config_parse(&config, "- GStreamer flip benchmark", entries, &argc, &argv, &error))
     {
-        values[i] = test();
-        sum += values[i];
-        max = std::max(max, values[i]);
+        g_printerr("%s\n", error->message);
+        return 1;
     }
 
-    gdouble mean = (gdouble)sum / count;
+    BenchReport* report = bench_report_new("gst");
+
+    /* what a stored report was measured against */
+    gchar* version = gst_version_string();
+    bench_report_set_info(report, "gstreamer", version);
+    g_free(version);
+    if (bench_config_get_n_geometries(&config) == 1)
+        bench_report_set_geometry(report, bench_config_get_geometry(&config, 0));
+    else
+        bench_report_set_info_int(report, "sweep", bench_config_get_n_geometries(&config));
 
-    gdouble sum2 = 0;
-    for (gint i = 0; i < count; i++)
+    App* app = &s_app;
+    g_mutex_init(&app->feed_lock);
+
+    if (app->ingest_name == NULL)
+        app->ingest = INGEST_NONE;
+    else if (g_strcmp0(app->ingest_name, "copy") == 0)
+        app->ingest = INGEST_COPY;
+    else if (g_strcmp0(app->ingest_name, "wrap") == 0)
+        app->ingest = INGEST_WRAP;
+    else if (g_strcmp0(app->ingest_name, "memfd") == 0)
+        app->ingest = INGEST_MEMFD;
+    else
+    {
+        g_printerr("unknown ingest mode %s\n", app->ingest_name);
+        return 1;
+    }
+    if (app->ingest != INGEST_NONE && app->pool)
+    {
+        g_printerr("--ingest and --pool can not be combined\n");
+        return 1;
+    }
+    if (app->element != NULL && !is_fastflip(app) && g_strcmp0(app->element, "videoflip") != 0)
+    {
+        g_printerr("unknown element %s\n", app->element);
+        return 1;
+    }
+    if (app->pipelines < 0)
+    {
+        g_printerr("pipelines must be positive\n");
+        return 1;
+    }
+    if ((app->pipelines > 0 || app->stream) && config.iterations_set)
+    {
+        g_printerr("--iterations can not be combined with --stream or --pipelines, see --frames\n");
+        return 1;
+    }
+    if (app->pipelines > 0 && (app->stream || app->pool || app->trace || app->cost || app->perf || app->ingest != INGEST_NONE))
+    {
+        g_printerr("--pipelines can not be combined with --stream, --pool, --trace, --cost, --perf or --ingest\n");
+        return 1;
+    }
+    if (app->pages_name != NULL)
+    {
+        if (!bench_pages_from_string(app->pages_name, &app->pages))
+        {
+            g_printerr("unknown pages %s\n", app->pages_name);
+            return 1;
+        }
+        /* both passes would add the same trace and cost metrics */
+        if (app->pipelines > 0 || app->trace || app->cost)
+        {
+            g_printerr("--pages can not be combined with --pipelines, --trace or --cost\n");
+            return 1;
+        }
+    }
+    if (app->source_path != NULL && (app->ingest != INGEST_NONE || app->pool || app->pipelines > 0 || app->pages_name != NULL))
+    {
+        g_printerr("--source can not be combined with --ingest, --pool, --pipelines or --pages\n");
+        return 1;
+    }
+    if (app->readahead < 0)
     {
-        sum2 += std::pow(values[i]- mean, 2);
+        g_printerr("readahead must not be negative\n");
+        return 1;
+    }
+    if (app->mem_node < -1)
+    {
+        g_printerr("mem-node must not be negative\n");
+        return 1;
+    }
+    if (app->stream)
+    {
+        if (app->trace)
+        {
+            g_printerr("--trace is only supported in batch mode\n");
+            return 1;
+        }
+        if (app->duration <= 0 && app->frames <= 0)
+            app->duration = 10;
     }
 
-    gdouble stdDev = std::sqrt(sum2 / (count - 1));
+    if (app->producer_cpus_name != NULL)
+    {
+        app->producer_cpus = bench_cpulist_parse(app->producer_cpus_name);
+        if (app->producer_cpus == NULL || app->producer_cpus->len == 0)
+        {
+            g_printerr("invalid cpu list %s\n", app->producer_cpus_name);
+            return 1;
+        }
+    }
+    if (app->stream_cpus_name != NULL)
+    {
+        app->stream_cpus = bench_cpulist_parse(app->stream_cpus_name);
+        if (app->stream_cpus == NULL || app->stream_cpus->len == 0)
+        {
+            g_printerr("invalid cpu list %s\n", app->stream_cpus_name);
+            return 1;
+        }
+    }
 
-    // TODO: max value
-    std::cout << "Mean: " << mean << " ms" <<std::endl;
-    std::cout << "Standard Deviation: " << stdDev << " ms" << std::endl;
-    std::cout << "Max: " << max << " ms" <<std::endl;
+    app->topology = bench_topology_new();
+    g_mutex_init(&app->placement_lock);
+    app->stream_placement = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 
-    cleanup();
+    /* the main thread produces outside of --pipelines, and allocates the
+     * pools either way */
+    if (app->producer_cpus != NULL)
+        bench_thread_add_start_hook(release_thread, app);
+    pin_producer(app, 0);
+
+    /* read once from the disk on the pinned producer, the runs then find the
+     * stack in the page cache as far as it fits */
+    if (app->source_path != NULL)
+    {
+        app->source = bench_source_new(app->source_path, app->readahead, &error);
+        check_error(&error);
+        bench_source_set_frame_size(app->source, bench_geometry_frame_size(bench_config_get_geometry(&config, 0)), &error);
+        check_error(&error);
+        app->source_read_ns = bench_source_read_cold(app->source);
+    }
+
+    /* registered with the core directly, GST_TRACERS is not needed */
+    if (app->cost)
+        app->cost_tracer = gst_cost_tracer_new();
+
+    /* before any pipeline, every streaming thread gets its counters as it starts */
+    if (app->perf)
+    {
+        config.perf = bench_perf_new(&error);
+        check_error(&error);
+    }
+
+    bench_calibrate(&config, report);
+    bench_report_set_info(report, "cost", app->cost ? "yes" : "no");
+    bench_report_set_info(report, "perf", app->perf ? "yes" : "no");
+    bench_report_set_info(report, "element", is_fastflip(app) ? "fastflip" : "videoflip");
+    if (is_fastflip(app))
+        bench_report_set_info_int(report, "flip-threads", MAX(app->flip_threads, 1));
+    bench_report_set_info(report, "allocation", app->pool ? "pool" : "new");
+    bench_report_set_info(report, "ingest", app->ingest_name != NULL ? app->ingest_name : "none");
+    bench_report_set_info(report, "pages", app->pages_name != NULL ? app->pages_name : "default");
+    bench_topology_report(app->topology, report);
+    if (app->producer_cpus != NULL)
+    {
+        gchar* list = bench_cpulist_to_string((const gint*)(gpointer)app->producer_cpus->data, app->producer_cpus->len);
+        bench_report_set_info(report, "producer-cpus", list);
+        g_free(list);
+    }
+    if (app->stream_cpus != NULL)
+    {
+        gchar* list = bench_cpulist_to_string((const gint*)(gpointer)app->stream_cpus->data, app->stream_cpus->len);
+        bench_report_set_info(report, "stream-cpus", list);
+        g_free(list);
+    }
+    if (app->mem_node >= 0)
+        bench_report_set_info_int(report, "mem-node", app->mem_node);
+    if (app->pages_name != NULL)
+        bench_report_set_info(report, "populate", app->populate ? "yes" : "no");
+    if (app->source != NULL)
+    {
+        bench_report_set_info(report, "source", app->source_path);
+        bench_report_set_info_int(report, "readahead", app->readahead);
+        bench_report_set_bandwidth(report, "Disk Bandwidth", app->source->size, app->source_read_ns);
+    }
+    if (app->pipelines > 0)
+    {
+        bench_report_set_info_int(report, "pipelines", app->pipelines);
+        bench_report_set_info(report, "queues", app->queues ? "yes" : "no");
+    }
+
+    for (guint g = 0; g < bench_config_get_n_geometries(&config); g++)
+    {
+        run_geometry(&config, report, bench_config_get_geometry(&config, g));
+
+        /* the 4K arena first, it is what the requested pages are compared to */
+        if (app->pages_name != NULL)
+        {
+            BenchPages requested = app->pages;
+
+            app->arena_pass = TRUE;
+            if (requested != BENCH_PAGES_4K)
+            {
+                app->pages = BENCH_PAGES_4K;
+                run_geometry(&config, report, bench_config_get_geometry(&config, g));
+                app->pages = requested;
+            }
+            run_geometry(&config, report, bench_config_get_geometry(&config, g));
+            app->arena_pass = FALSE;
+        }
+    }
+
+    /* which element ran where, known once the threads started */
+    if (g_hash_table_size(app->stream_placement) > 0)
+    {
+        gchar* placement = stream_placement_to_string(app);
+        bench_report_set_info(report, "stream-threads", placement);
+        g_free(placement);
+    }
+
+    bench_finish(&config, report, &error);
+    check_error(&error);
+
+    if (app->producer_cpus != NULL)
+        bench_thread_remove_start_hook(release_thread, app);
+    g_hash_table_unref(app->stream_placement);
+    g_mutex_clear(&app->placement_lock);
+    bench_topology_free(app->topology);
+    if (app->producer_cpus != NULL)
+        g_array_unref(app->producer_cpus);
+    if (app->stream_cpus != NULL)
+        g_array_unref(app->stream_cpus);
+    if (app->source != NULL)
+        bench_source_free(app->source);
+    g_free(app->source_path);
+    g_free(app->producer_cpus_name);
+    g_free(app->stream_cpus_name);
+    g_mutex_clear(&app->feed_lock);
+    g_free(app->ingest_name);
+    g_free(app->pages_name);
+    g_free(app->element);
+    if (app->cost_tracer != NULL)
+        gst_object_unref(app->cost_tracer);
+    bench_report_free(report);
+    bench_config_clear(&config);
 
     return 0;
 }
\ No newline at end of file
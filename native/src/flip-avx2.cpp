@@ -0,0 +1,26 @@
+#include <immintrin.h>
+
+#include "flip-impl.h"
+
+/* pshufb only works within 128 bit lanes, the lanes are swapped afterwards */
+struct Avx2
+{
+    static const guint bytes = 32;
+
+    template <guint Bpp>
+    static inline void
+    reverse(const guint8* src, guint8* dst)
+    {
+        const __m256i mask = _mm256_load_si256((const __m256i*)reverse_mask<Bpp>());
+        __m256i v = _mm256_loadu_si256((const __m256i*)src);
+
+        v = _mm256_shuffle_epi8(v, mask);
+        _mm256_storeu_si256((__m256i*)dst, _mm256_permute4x64_epi64(v, 0x4E));
+    }
+};
+
+FlipFunc
+flip_get_avx2(guint bpp, guint width)
+{
+    return flip_select<Avx2>(bpp, width);
+}
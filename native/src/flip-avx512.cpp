@@ -0,0 +1,28 @@
+#include <immintrin.h>
+
+#include "flip-impl.h"
+
+/* Byte shuffles need AVX-512BW, the four 128 bit lanes are reversed with a
+ * qword permute */
+struct Avx512
+{
+    static const guint bytes = 64;
+
+    template <guint Bpp>
+    static inline void
+    reverse(const guint8* src, guint8* dst)
+    {
+        const __m512i mask = _mm512_load_si512((const void*)reverse_mask<Bpp>());
+        const __m512i lanes = _mm512_set_epi64(1, 0, 3, 2, 5, 4, 7, 6);
+        __m512i v = _mm512_loadu_si512((const void*)src);
+
+        v = _mm512_shuffle_epi8(v, mask);
+        _mm512_storeu_si512((void*)dst, _mm512_permutexvar_epi64(lanes, v));
+    }
+};
+
+FlipFunc
+flip_get_avx512(guint bpp, guint width)
+{
+    return flip_select<Avx512>(bpp, width);
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <string.h>
+
+#include "flip.h"
+
+/* Shared row loop, included by every kernel. Isa provides the vector width in
+ * bytes and reverse<Bpp>(), which stores the pixels of one vector in reverse
+ * order. A Width of 0 means the width is only known at runtime. */
+
+/* pshufb masks reversing the pixels of each 16 byte lane, repeated for the
+ * four lanes of a 512 bit register */
+template <guint Bpp>
+static inline const guint8* reverse_mask();
+
+template <>
+inline const guint8*
+reverse_mask<1>()
+{
+    alignas(64) static const guint8 mask[64] = {
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0
+    };
+    return mask;
+}
+
+template <>
+inline const guint8*
+reverse_mask<2>()
+{
+    alignas(64) static const guint8 mask[64] = {
+        14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1,
+        14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1,
+        14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1,
+        14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1
+    };
+    return mask;
+}
+
+template <>
+inline const guint8*
+reverse_mask<4>()
+{
+    alignas(64) static const guint8 mask[64] = {
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3
+    };
+    return mask;
+}
+
+template <typename Isa, guint Bpp, guint Width>
+static void
+flip_frame(const guint8* src, guint8* dst, guint width, guint height)
+{
+    const guint w = Width != 0 ? Width : width;
+    const gsize stride = (gsize)w * Bpp;
+    const guint n = Isa::bytes / Bpp;
+
+    for (guint y = 0; y < height; y++)
+    {
+        const guint8* s = src + y * stride;
+        guint8* d = dst + y * stride;
+        guint x = 0;
+
+        for (; x + n <= w; x += n)
+            Isa::template reverse<Bpp>(s + (gsize)(w - x - n) * Bpp, d + (gsize)x * Bpp);
+
+        for (; x < w; x++)
+            memcpy(d + (gsize)x * Bpp, s + (gsize)(w - 1 - x) * Bpp, Bpp);
+    }
+}
+
+template <typename Isa, guint Bpp>
+static FlipFunc
+flip_select_width(guint width)
+{
+    switch (width)
+    {
+    case 512:
+        return flip_frame<Isa, Bpp, 512>;
+    case 1024:
+        return flip_frame<Isa, Bpp, 1024>;
+    case 2048:
+        return flip_frame<Isa, Bpp, 2048>;
+    case 4096:
+        return flip_frame<Isa, Bpp, 4096>;
+    default:
+        return flip_frame<Isa, Bpp, 0>;
+    }
+}
+
+template <typename Isa>
+static FlipFunc
+flip_select(guint bpp, guint width)
+{
+    switch (bpp)
+    {
+    case 1:
+        return flip_select_width<Isa, 1>(width);
+    case 2:
+        return flip_select_width<Isa, 2>(width);
+    case 4:
+        return flip_select_width<Isa, 4>(width);
+    default:
+        return NULL;
+    }
+}
@@ -0,0 +1,27 @@
+#include "flip-impl.h"
+
+/* Reverses 4 bytes at a time in a general purpose register */
+struct Scalar
+{
+    static const guint bytes = 4;
+
+    template <guint Bpp>
+    static inline void
+    reverse(const guint8* src, guint8* dst)
+    {
+        guint32 v;
+
+        memcpy(&v, src, sizeof(v));
+        if (Bpp == 1)
+            v = GUINT32_SWAP_LE_BE(v);
+        else if (Bpp == 2)
+            v = (v >> 16) | (v << 16);
+        memcpy(dst, &v, sizeof(v));
+    }
+};
+
+FlipFunc
+flip_get_scalar(guint bpp, guint width)
+{
+    return flip_select<Scalar>(bpp, width);
+}
@@ -0,0 +1,24 @@
+#include <immintrin.h>
+
+#include "flip-impl.h"
+
+struct Sse4
+{
+    static const guint bytes = 16;
+
+    template <guint Bpp>
+    static inline void
+    reverse(const guint8* src, guint8* dst)
+    {
+        const __m128i mask = _mm_load_si128((const __m128i*)reverse_mask<Bpp>());
+        __m128i v = _mm_loadu_si128((const __m128i*)src);
+
+        _mm_storeu_si128((__m128i*)dst, _mm_shuffle_epi8(v, mask));
+    }
+};
+
+FlipFunc
+flip_get_sse4(guint bpp, guint width)
+{
+    return flip_select<Sse4>(bpp, width);
+}
@@ -0,0 +1,108 @@
+#include "flip.h"
+
+#ifdef FLIP_X86
+#include <cpuid.h>
+#endif
+
+static const gchar* kernel_names[FLIP_N_KERNELS] = { "scalar", "sse4", "avx2", "avx512" };
+
+const gchar*
+flip_kernel_to_string(FlipKernel kernel)
+{
+    g_return_val_if_fail(kernel < FLIP_N_KERNELS, NULL);
+
+    return kernel_names[kernel];
+}
+
+gboolean
+flip_kernel_from_string(const gchar* str, FlipKernel* kernel)
+{
+    for (guint i = 0; i < FLIP_N_KERNELS; i++)
+    {
+        if (g_ascii_strcasecmp(str, kernel_names[i]) == 0)
+        {
+            *kernel = (FlipKernel)i;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+#ifdef FLIP_X86
+/* Register state the OS saves on context switches, AVX is only usable if it
+ * includes the YMM (and for AVX-512 the opmask and ZMM) registers */
+static guint64
+xgetbv()
+{
+    guint32 eax, edx;
+
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+
+    return ((guint64)edx << 32) | eax;
+}
+
+static guint
+detect_kernels()
+{
+    guint eax, ebx, ecx, edx;
+    guint kernels = 1 << FLIP_KERNEL_SCALAR;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return kernels;
+
+    if ((ecx & bit_SSSE3) && (ecx & bit_SSE4_1))
+        kernels |= 1 << FLIP_KERNEL_SSE4;
+
+    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX))
+        return kernels;
+
+    guint64 xcr0 = xgetbv();
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return kernels;
+
+    if ((xcr0 & 0x06) == 0x06 && (ebx & bit_AVX2))
+        kernels |= 1 << FLIP_KERNEL_AVX2;
+    if ((xcr0 & 0xE6) == 0xE6 && (ebx & bit_AVX512F) && (ebx & bit_AVX512BW))
+        kernels |= 1 << FLIP_KERNEL_AVX512;
+
+    return kernels;
+}
+#else
+static guint
+detect_kernels()
+{
+    return 1 << FLIP_KERNEL_SCALAR;
+}
+#endif
+
+gboolean
+flip_kernel_supported(FlipKernel kernel)
+{
+    static guint kernels = detect_kernels();
+
+    g_return_val_if_fail(kernel < FLIP_N_KERNELS, FALSE);
+
+    return (kernels & (1 << kernel)) != 0;
+}
+
+FlipFunc
+flip_kernel_get(FlipKernel kernel, guint bpp, guint width)
+{
+    switch (kernel)
+    {
+    case FLIP_KERNEL_SCALAR:
+        return flip_get_scalar(bpp, width);
+#ifdef FLIP_X86
+    case FLIP_KERNEL_SSE4:
+        return flip_get_sse4(bpp, width);
+    case FLIP_KERNEL_AVX2:
+        return flip_get_avx2(bpp, width);
+    case FLIP_KERNEL_AVX512:
+        return flip_get_avx512(bpp, width);
+#endif
+    default:
+        return NULL;
+    }
+}
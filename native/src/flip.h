@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glib.h>
+
+/* Flips width x height pixels of one frame horizontally from src into dst */
+typedef void (*FlipFunc)(const guint8* src, guint8* dst, guint width, guint height);
+
+typedef enum
+{
+    FLIP_KERNEL_SCALAR,
+    FLIP_KERNEL_SSE4,
+    FLIP_KERNEL_AVX2,
+    FLIP_KERNEL_AVX512,
+    FLIP_N_KERNELS,
+} FlipKernel;
+
+const gchar* flip_kernel_to_string(FlipKernel kernel);
+gboolean flip_kernel_from_string(const gchar* str, FlipKernel* kernel);
+
+/* Whether the CPU and OS can run the kernel, checked once with CPUID */
+gboolean flip_kernel_supported(FlipKernel kernel);
+
+/* The kernel for bpp byte pixels, specialized for the common widths, NULL if
+ * the kernel is not built in or bpp is not 1, 2 or 4 */
+FlipFunc flip_kernel_get(FlipKernel kernel, guint bpp, guint width);
+
+/* One per instruction set, each built with its own -m flags */
+FlipFunc flip_get_scalar(guint bpp, guint width);
+FlipFunc flip_get_sse4(guint bpp, guint width);
+FlipFunc flip_get_avx2(guint bpp, guint width);
+FlipFunc flip_get_avx512(guint bpp, guint width);
@@ -0,0 +1,421 @@
+#include <benchcore/bench.h>
+#include <iostream>
+#include <string.h>
+
+#include "flip.h"
+#include "pool.h"
+#include "values.h"
+
+/* Structure to contain all our information */
+typedef struct _CustomData
+{
+    /* geometry of the current run, see set_geometry() */
+    BenchGeometry geometry;
+    gsize frame_size;
+
+    guint8* src;
+    guint8* dst;
+
+    FlipFunc func;
+
+    /* parallel runs, see flip_tile() */
+    Pool* pool;
+    guint tile_rows;
+    guint n_tiles;
+} CustomData;
+
+/* Command line options */
+typedef struct _Options
+{
+    gchar* kernel_name;
+    gchar* save_baseline;
+    gint threads;
+    gint tile_rows;
+} Options;
+
+Options options;
+
+static const GOptionEntry entries[] = {
+    { "kernel", 'k', 0, G_OPTION_ARG_STRING, &options.kernel_name, "Flip kernel, all runs every kernel the CPU supports (default)", "scalar|sse4|avx2|avx512|all" },
+    { "threads", 't', 0, G_OPTION_ARG_INT, &options.threads, "Also run the kernel on a work stealing pool of 1 up to N pinned threads", "N" },
+    { "tile-rows", 0, 0, G_OPTION_ARG_INT, &options.tile_rows, "Rows per task of the pool (default 64)", "ROWS" },
+    { "save-baseline", 0, 0, G_OPTION_ARG_FILENAME, &options.save_baseline, "Write the best kernel per geometry to FILE, read by --baseline", "FILE" },
+    { NULL }
+};
+
+static void
+check_error(GError** error)
+{
+    if (*error != NULL)
+    {
+        g_error("Catched error: %s", (*error)->message);
+        exit(-1);
+    }
+}
+
+CustomData data;
+
+/* Offset and rows of one task, frames are split into tiles of tile_rows */
+static gsize
+tile_offset(guint task, guint* rows)
+{
+    guint frame = task / data.n_tiles;
+    guint y = (task % data.n_tiles) * data.tile_rows;
+    gsize row_size = data.frame_size / data.geometry.height;
+
+    *rows = MIN(data.tile_rows, data.geometry.height - y);
+
+    return frame * data.frame_size + y * row_size;
+}
+
+static void
+fill_tile(guint task, gpointer user_data)
+{
+    (void)user_data;
+
+    guint rows;
+    gsize offset = tile_offset(task, &rows);
+    gsize size = rows * (data.frame_size / data.geometry.height);
+
+    for (gsize i = offset; i < offset + size; i++)
+        data.src[i] = (guint8)(i ^ (i >> 8));
+    memset(data.dst + offset, 0, size);
+}
+
+static void
+flip_tile(guint task, gpointer user_data)
+{
+    (void)user_data;
+
+    guint rows;
+    gsize offset = tile_offset(task, &rows);
+
+    data.func(data.src + offset, data.dst + offset, data.geometry.width, rows);
+}
+
+/* Allocates a source batch with a pattern, so flipped frames can be checked,
+ * and the destination batch. With a pool the pages are first touched by the
+ * worker that owns the tile, so they end up on its NUMA node. */
+void init(const BenchGeometry* geometry, Pool* pool)
+{
+    data.geometry = *geometry;
+    data.frame_size = bench_geometry_frame_size(geometry);
+    data.tile_rows = options.tile_rows;
+    data.n_tiles = (geometry->height + data.tile_rows - 1) / data.tile_rows;
+
+    gsize size = bench_geometry_batch_size(geometry);
+
+    data.src = (guint8*)g_malloc(size);
+    data.dst = (guint8*)g_malloc(size);
+
+    if (pool != NULL)
+    {
+        pool_run(pool, geometry->number * data.n_tiles, fill_tile, NULL);
+    }
+    else
+    {
+        for (guint i = 0; i < geometry->number * data.n_tiles; i++)
+            fill_tile(i, NULL);
+    }
+}
+
+void free()
+{
+    g_free(data.src);
+    g_free(data.dst);
+    data.src = NULL;
+    data.dst = NULL;
+}
+
+/* Compares the first flipped frame pixel by pixel with the source */
+static void
+check_frame(FlipKernel kernel)
+{
+    guint bpp = bench_format_get_bpp(data.geometry.format);
+    guint width = data.geometry.width;
+
+    data.func(data.src, data.dst, width, data.geometry.height);
+
+    for (guint y = 0; y < data.geometry.height; y++)
+    {
+        const guint8* s = data.src + (gsize)y * width * bpp;
+        const guint8* d = data.dst + (gsize)y * width * bpp;
+
+        for (guint x = 0; x < width; x++)
+        {
+            if (memcmp(d + (gsize)x * bpp, s + (gsize)(width - 1 - x) * bpp, bpp) != 0)
+            {
+                g_error("%s kernel flipped pixel %u,%u wrong", flip_kernel_to_string(kernel), x, y);
+                exit(-1);
+            }
+        }
+    }
+}
+
+gint64 test(gpointer user_data)
+{
+    (void)user_data;
+
+    gint64 t1 = bench_now_ns();
+
+    for (guint i = 0; i < data.geometry.number; i++)
+    {
+        data.func(data.src + i * data.frame_size, data.dst + i * data.frame_size,
+            data.geometry.width, data.geometry.height);
+    }
+
+    gint64 t2 = bench_now_ns();
+
+    return t2 - t1;
+}
+
+gint64 test_pool(gpointer user_data)
+{
+    (void)user_data;
+
+    gint64 t1 = bench_now_ns();
+
+    pool_run(data.pool, data.geometry.number * data.n_tiles, flip_tile, NULL);
+
+    gint64 t2 = bench_now_ns();
+
+    return t2 - t1;
+}
+
+/* Runs kernel on 1, 2, 4, ... up to n_threads workers and reports speedup
+ * and parallel efficiency relative to one worker */
+static void
+run_scaling(const BenchConfig* config, BenchReport* report, const gint* cpus, Pool* full, FlipKernel kernel)
+{
+    const BenchGeometry* geometry = &data.geometry;
+    gdouble single = 0;
+
+    data.func = flip_kernel_get(kernel, bench_format_get_bpp(geometry->format), geometry->width);
+
+    for (gint n = 1;; n = MIN(2 * n, options.threads))
+    {
+        data.pool = n == options.threads ? full : pool_new(n, cpus);
+        data.pool->steals = 0;
+
+        gchar* base = g_strdup_printf("threads %d %s", n, flip_kernel_to_string(kernel));
+        gchar* metric = bench_config_get_metric_name(config, base, geometry);
+        BenchRecorder* run = bench_report_add_metric(report, metric, config->iterations);
+        BenchStats stats;
+
+        bench_run(config, run, test_pool, NULL);
+        bench_recorder_compute_stats(run, &stats);
+        if (n == 1)
+            single = stats.p50;
+
+        gchar* name = g_strdup_printf("Speedup %d", n);
+        gchar* value = bench_config_get_metric_name(config, name, geometry);
+        bench_report_set_value(report, value, stats.p50 > 0 ? single / stats.p50 : 0, "x");
+        g_free(value);
+        g_free(name);
+
+        name = g_strdup_printf("Efficiency %d", n);
+        value = bench_config_get_metric_name(config, name, geometry);
+        bench_report_set_value(report, value, stats.p50 > 0 ? 100 * single / stats.p50 / n : 0, "%");
+        g_free(value);
+        g_free(name);
+
+        name = g_strdup_printf("Bandwidth %d", n);
+        value = bench_config_get_metric_name(config, name, geometry);
+        bench_report_set_bandwidth(report, value, 2.0 * bench_geometry_batch_size(geometry), stats.p50);
+        g_free(value);
+        g_free(name);
+
+        name = g_strdup_printf("Steals %d", n);
+        value = bench_config_get_metric_name(config, name, geometry);
+        bench_report_set_value(report, value, (gdouble)data.pool->steals / config->iterations, "per run");
+        g_free(value);
+        g_free(name);
+
+        if (data.pool != full)
+            pool_free(data.pool);
+        data.pool = NULL;
+
+        g_free(metric);
+        g_free(base);
+
+        if (n == options.threads)
+            break;
+    }
+}
+
+int
+main(int argc, char* argv[])
+{
+    BenchConfig config;
+    GError* error = NULL;
+
+    bench_config_init(&config, WIDTH, HEIGHT, NUMBER, BENCH_FORMAT_RGBA);
+    if (!bench_config_parse(&config, "- native flip baseline", entries, &argc, &argv, &error))
+    {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+
+    gint first_kernel = 0, last_kernel = FLIP_N_KERNELS - 1;
+    if (options.kernel_name != NULL && g_strcmp0(options.kernel_name, "all") != 0)
+    {
+        FlipKernel kernel;
+
+        if (!flip_kernel_from_string(options.kernel_name, &kernel))
+        {
+            g_printerr("unknown kernel %s\n", options.kernel_name);
+            return 1;
+        }
+        if (!flip_kernel_supported(kernel))
+        {
+            g_printerr("kernel %s is not supported by this CPU\n", options.kernel_name);
+            return 1;
+        }
+        first_kernel = last_kernel = kernel;
+    }
+
+    if (options.threads < 0)
+    {
+        g_printerr("threads must be positive\n");
+        return 1;
+    }
+    if (options.tile_rows == 0)
+        options.tile_rows = 64;
+    if (options.tile_rows < 0)
+    {
+        g_printerr("tile-rows must be positive\n");
+        return 1;
+    }
+
+    BenchReport* report = bench_report_new("native");
+    guint n_geometries = bench_config_get_n_geometries(&config);
+    if (n_geometries == 1)
+        bench_report_set_geometry(report, bench_config_get_geometry(&config, 0));
+    else
+        bench_report_set_info_int(report, "sweep", n_geometries);
+
+    GString* supported = g_string_new(NULL);
+    for (gint kernel = 0; kernel < FLIP_N_KERNELS; kernel++)
+    {
+        if (flip_kernel_supported((FlipKernel)kernel))
+            g_string_append_printf(supported, "%s%s", supported->len > 0 ? "," : "", flip_kernel_to_string((FlipKernel)kernel));
+    }
+    bench_report_set_info(report, "kernels", supported->str);
+    g_string_free(supported, TRUE);
+
+    bench_calibrate(&config, report);
+
+    gint* cpus = NULL;
+    Pool* pool = NULL;
+    if (options.threads > 0)
+    {
+        BenchTopology* topology = bench_topology_new();
+        GString* pinned = g_string_new(NULL);
+
+        cpus = g_new(gint, options.threads);
+        for (gint i = 0; i < options.threads; i++)
+        {
+            cpus[i] = topology->cpus[i % topology->n_cpus];
+            g_string_append_printf(pinned, "%s%d", i > 0 ? "," : "", cpus[i]);
+        }
+
+        /* also places the batches, see init() */
+        pool = pool_new(options.threads, cpus);
+
+        bench_report_set_info_int(report, "threads", options.threads);
+        bench_report_set_info_int(report, "tile-rows", options.tile_rows);
+        bench_topology_report(topology, report);
+        bench_report_set_info(report, "cpus", pinned->str);
+        g_string_free(pinned, TRUE);
+        bench_topology_free(topology);
+    }
+
+    BenchBaseline* baseline = bench_baseline_new();
+
+    for (guint g = 0; g < n_geometries; g++)
+    {
+        const BenchGeometry* geometry = bench_config_get_geometry(&config, g);
+        BenchRecorder* runs[FLIP_N_KERNELS] = { NULL };
+        gdouble medians[FLIP_N_KERNELS] = { 0 };
+        gint best = -1;
+
+        init(geometry, pool);
+
+        for (gint kernel = first_kernel; kernel <= last_kernel; kernel++)
+        {
+            if (!flip_kernel_supported((FlipKernel)kernel))
+                continue;
+
+            data.func = flip_kernel_get((FlipKernel)kernel, bench_format_get_bpp(geometry->format), geometry->width);
+            if (data.func == NULL)
+                continue;
+
+            check_frame((FlipKernel)kernel);
+
+            gchar* base = g_strdup_printf("run %s", flip_kernel_to_string((FlipKernel)kernel));
+            gchar* metric = bench_config_get_metric_name(&config, base, geometry);
+            BenchStats stats;
+
+            runs[kernel] = bench_report_add_metric(report, metric, config.iterations);
+            bench_run(&config, runs[kernel], test, NULL);
+
+            /* read and written once per batch */
+            bench_recorder_compute_stats(runs[kernel], &stats);
+            medians[kernel] = stats.p50;
+            gchar* value_base = g_strdup_printf("Bandwidth %s", flip_kernel_to_string((FlipKernel)kernel));
+            gchar* value = bench_config_get_metric_name(&config, value_base, geometry);
+            bench_report_set_bandwidth(report, value, 2.0 * bench_geometry_batch_size(geometry), stats.p50);
+
+            if (stats.p50 > 0 && (best < 0 || stats.p50 < medians[best]))
+                best = kernel;
+
+            g_free(value);
+            g_free(value_base);
+            g_free(metric);
+            g_free(base);
+        }
+
+        if (best >= 0 && pool != NULL)
+            run_scaling(&config, report, cpus, pool, first_kernel == last_kernel ? (FlipKernel)first_kernel : (FlipKernel)best);
+
+        free();
+
+        if (best < 0)
+            continue;
+
+        /* every kernel relative to the fastest one of this geometry */
+        for (gint kernel = first_kernel; kernel <= last_kernel; kernel++)
+        {
+            if (runs[kernel] == NULL)
+                continue;
+
+            gchar* value_base = g_strdup_printf("%s of Best", flip_kernel_to_string((FlipKernel)kernel));
+            gchar* value = bench_config_get_metric_name(&config, value_base, geometry);
+            bench_report_set_value(report, value, 100 * medians[best] / medians[kernel], "%");
+            g_free(value);
+            g_free(value_base);
+        }
+
+        bench_baseline_set(baseline, geometry, flip_kernel_to_string((FlipKernel)best), medians[best]);
+    }
+
+    bench_finish(&config, report, &error);
+    check_error(&error);
+
+    if (options.save_baseline != NULL)
+    {
+        bench_baseline_save(baseline, options.save_baseline, &error);
+        check_error(&error);
+    }
+
+    if (pool != NULL)
+        pool_free(pool);
+    g_free(cpus);
+    bench_baseline_free(baseline);
+    bench_report_free(report);
+    bench_config_clear(&config);
+    g_free(options.kernel_name);
+    g_free(options.save_baseline);
+
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include "pool.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+static gboolean
+take_own(PoolWorker* worker, guint* task)
+{
+    gboolean ret = FALSE;
+
+    g_mutex_lock(&worker->lock);
+    if (worker->begin < worker->end)
+    {
+        *task = worker->begin++;
+        ret = TRUE;
+    }
+    g_mutex_unlock(&worker->lock);
+
+    return ret;
+}
+
+static gboolean
+steal(PoolWorker* victim, guint* task)
+{
+    gboolean ret = FALSE;
+
+    g_mutex_lock(&victim->lock);
+    if (victim->begin < victim->end)
+    {
+        *task = --victim->end;
+        ret = TRUE;
+    }
+    g_mutex_unlock(&victim->lock);
+
+    return ret;
+}
+
+/* Runs own tasks first, then steals from the other workers starting with the
+ * next one until a whole round finds nothing. Tasks are never added during a
+ * batch, so an empty round means the batch is done for this worker. */
+static void
+work(PoolWorker* worker)
+{
+    Pool* pool = worker->pool;
+    guint task;
+
+    for (;;)
+    {
+        if (take_own(worker, &task))
+        {
+            pool->func(task, pool->user_data);
+            continue;
+        }
+
+        gboolean found = FALSE;
+        for (guint i = 1; i < pool->n_workers && !found; i++)
+        {
+            found = steal(&pool->workers[(worker->index + i) % pool->n_workers], &task);
+        }
+        if (!found)
+            break;
+
+        pool->steals.fetch_add(1, std::memory_order_relaxed);
+        pool->func(task, pool->user_data);
+    }
+}
+
+static gpointer
+worker_thread(gpointer user_data)
+{
+    PoolWorker* worker = (PoolWorker*)user_data;
+    Pool* pool = worker->pool;
+    guint64 generation = 0;
+
+    if (worker->cpu >= 0)
+    {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(worker->cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            g_warning("could not pin worker %u to cpu %d", worker->index, worker->cpu);
+    }
+
+    for (;;)
+    {
+        g_mutex_lock(&pool->lock);
+        while (pool->generation == generation && !pool->quit)
+            g_cond_wait(&pool->start, &pool->lock);
+        if (pool->quit)
+        {
+            g_mutex_unlock(&pool->lock);
+            break;
+        }
+        generation = pool->generation;
+        g_mutex_unlock(&pool->lock);
+
+        work(worker);
+
+        g_mutex_lock(&pool->lock);
+        if (--pool->running == 0)
+            g_cond_signal(&pool->done);
+        g_mutex_unlock(&pool->lock);
+    }
+
+    return NULL;
+}
+
+Pool*
+pool_new(guint n_workers, const gint* cpus)
+{
+    Pool* pool = g_new0(Pool, 1);
+
+    pool->n_workers = n_workers;
+    /* malloc only aligns to 16 bytes, the workers need their own lines */
+    gpointer workers = NULL;
+    if (posix_memalign(&workers, alignof(PoolWorker), n_workers * sizeof(PoolWorker)) != 0)
+        g_error("failed to allocate %u pool workers", n_workers);
+    memset(workers, 0, n_workers * sizeof(PoolWorker));
+    pool->workers = (PoolWorker*)workers;
+    pool->threads = g_new0(GThread*, n_workers);
+    g_mutex_init(&pool->lock);
+    g_cond_init(&pool->start);
+    g_cond_init(&pool->done);
+    pool->steals = 0;
+
+    for (guint i = 0; i < n_workers; i++)
+    {
+        PoolWorker* worker = &pool->workers[i];
+
+        worker->pool = pool;
+        worker->index = i;
+        worker->cpu = cpus != NULL ? cpus[i] : -1;
+        g_mutex_init(&worker->lock);
+    }
+
+    for (guint i = 0; i < n_workers; i++)
+    {
+        pool->threads[i] = g_thread_new("pool-worker", worker_thread, &pool->workers[i]);
+    }
+
+    return pool;
+}
+
+void
+pool_free(Pool* pool)
+{
+    g_mutex_lock(&pool->lock);
+    pool->quit = TRUE;
+    g_cond_broadcast(&pool->start);
+    g_mutex_unlock(&pool->lock);
+
+    for (guint i = 0; i < pool->n_workers; i++)
+    {
+        g_thread_join(pool->threads[i]);
+        g_mutex_clear(&pool->workers[i].lock);
+    }
+
+    g_cond_clear(&pool->done);
+    g_cond_clear(&pool->start);
+    g_mutex_clear(&pool->lock);
+    g_free(pool->threads);
+    free(pool->workers);
+    g_free(pool);
+}
+
+void
+pool_run(Pool* pool, guint n_tasks, PoolFunc func, gpointer user_data)
+{
+    for (guint i = 0; i < pool->n_workers; i++)
+    {
+        PoolWorker* worker = &pool->workers[i];
+
+        g_mutex_lock(&worker->lock);
+        worker->begin = (guint)((guint64)n_tasks * i / pool->n_workers);
+        worker->end = (guint)((guint64)n_tasks * (i + 1) / pool->n_workers);
+        g_mutex_unlock(&worker->lock);
+    }
+
+    g_mutex_lock(&pool->lock);
+    pool->func = func;
+    pool->user_data = user_data;
+    pool->running = pool->n_workers;
+    pool->generation++;
+    g_cond_broadcast(&pool->start);
+    while (pool->running > 0)
+        g_cond_wait(&pool->done, &pool->lock);
+    g_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glib.h>
+#include <atomic>
+
+typedef struct _Pool Pool;
+typedef struct _PoolWorker PoolWorker;
+
+/* Runs task with the index of the task, from any worker thread */
+typedef void (*PoolFunc)(guint task, gpointer user_data);
+
+/* Tasks [begin, end) left to a worker. The owner takes from the front, idle
+ * workers steal from the back, so a worker walks its tasks in memory order. */
+struct alignas(64) _PoolWorker
+{
+    Pool* pool;
+    guint index;
+    gint cpu;
+
+    GMutex lock;
+    guint begin;
+    guint end;
+};
+
+/* Fixed set of pinned threads that run batches of independent tasks with
+ * work stealing */
+struct _Pool
+{
+    guint n_workers;
+    PoolWorker* workers;
+    GThread** threads;
+
+    GMutex lock;
+    GCond start;
+    GCond done;
+    guint64 generation;
+    guint running;
+    gboolean quit;
+
+    PoolFunc func;
+    gpointer user_data;
+
+    std::atomic<guint64> steals;
+};
+
+/* cpus holds the CPU each worker is pinned to, or is NULL to not pin */
+Pool* pool_new(guint n_workers, const gint* cpus);
+void pool_free(Pool* pool);
+
+/* Splits n_tasks into one contiguous range per worker and returns when all
+ * tasks ran */
+void pool_run(Pool* pool, guint n_tasks, PoolFunc func, gpointer user_data);
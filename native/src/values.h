@@ -0,0 +1,5 @@
+#pragma once
+
+#define WIDTH 512u
+#define HEIGHT 512u
+#define NUMBER 1000u
\ No newline at end of file
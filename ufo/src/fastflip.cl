@@ -0,0 +1,69 @@
+/* Horizontal flip of float frames, memory-in has converted the pixels to
+ * float already. Every work item writes a contiguous run of the output row
+ * so neighbouring work items write neighbouring addresses, the mirrored
+ * reads are what goes in reverse. */
+
+kernel void
+fastflip_scalar (global const float *input,
+                 global float *output,
+                 const uint width,
+                 const uint height)
+{
+    const uint x = get_global_id (0);
+    const uint y = get_global_id (1);
+
+    if (x >= width || y >= height)
+        return;
+
+    output[y * width + x] = input[y * width + width - 1 - x];
+}
+
+kernel void
+fastflip_vec4 (global const float *input,
+               global float *output,
+               const uint width,
+               const uint height)
+{
+    const uint x = get_global_id (0) * 4;
+    const uint y = get_global_id (1);
+
+    if (x >= width || y >= height)
+        return;
+
+    global const float *in = input + y * width;
+    global float *out = output + y * width;
+
+    if (x + 4 <= width) {
+        float4 v = vload4 (0, in + width - x - 4);
+        vstore4 (v.s3210, 0, out + x);
+    }
+    else {
+        for (uint i = x; i < width; i++)
+            out[i] = in[width - 1 - i];
+    }
+}
+
+kernel void
+fastflip_vec16 (global const float *input,
+                global float *output,
+                const uint width,
+                const uint height)
+{
+    const uint x = get_global_id (0) * 16;
+    const uint y = get_global_id (1);
+
+    if (x >= width || y >= height)
+        return;
+
+    global const float *in = input + y * width;
+    global float *out = output + y * width;
+
+    if (x + 16 <= width) {
+        float16 v = vload16 (0, in + width - x - 16);
+        vstore16 (v.sFEDCBA9876543210, 0, out + x);
+    }
+    else {
+        for (uint i = x; i < width; i++)
+            out[i] = in[width - 1 - i];
+    }
+}
@@ -1,10 +1,41 @@
 #include <ufo/ufo.h>
+#include <benchcore/bench.h>
 #include <iostream>
-#include <chrono>
-#include <cmath>
 #include <CL/cl.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <errno.h>
 
 #include "values.h"
+#include "profile.h"
+
+typedef enum
+{
+    OUTPUT_MALLOC,
+    OUTPUT_ARENA,
+    OUTPUT_PINNED,
+} Output;
+
+typedef enum
+{
+    INPUT_HOST,
+    INPUT_DEVICE,
+    INPUT_PINNED,
+    INPUT_USE_HOST_PTR,
+    N_INPUTS,
+} Input;
+
+static const gchar* input_names[N_INPUTS] = { "host", "device", "pinned", "use-host-ptr" };
+
+typedef enum
+{
+    FLIP_STOCK,
+    FLIP_FAST,
+    N_FLIPS,
+} Flip;
+
+/* plugin names of the flip tasks, fastflip is built in this tree */
+static const gchar* flip_names[N_FLIPS] = { "flip", "fastflip" };
 
 /* Structure to contain all our information, so we can pass it to callbacks */
 typedef struct _CustomData
@@ -13,13 +44,107 @@ typedef struct _CustomData
     UfoPluginManager* manager;
     UfoBaseScheduler* scheduler;
     UfoResources* res;
+    cl_command_queue queue;
     cl_mem buffer;
 
+    /* memory-in source of the current placement, see init_input() */
+    gpointer input;
+    gint input_location;
+    gpointer input_host;
+    /* host input read straight from the source, the next batch every run */
+    gboolean input_source;
+
     UfoTaskNode* memory_in;
     UfoTaskNode* flip;
     UfoTaskNode* memory_out;
+
+    BenchRecorder* cold;
+
+    /* per phase device time and idle time of the runs, see profile_end() */
+    BenchRecorder* phases[N_PROFILE_PHASES];
+    BenchRecorder* idle;
+    ProfileRun profile;
+
+    /* geometry of the current run, see set_geometry() */
+    BenchGeometry geometry;
+    gsize input_size;
+    gsize output_size;
+
+    /* flip task of the current run, see build_graph() */
+    Flip flip_task;
+
+    /* memory-out target reused by every run, see init_output() */
+    gpointer output;
+    cl_mem output_mem;
+    gboolean output_locked;
+
+    /* host memory on arenas of pages in the later passes, see new_arena() */
+    gboolean arena_pass;
+    BenchPages pages;
+    BenchArena* input_arena;
+    BenchArena* output_arena;
+    BenchPages arena_pages;
 } CustomData;
 
+/* Command line options, kept apart from CustomData which init() clears */
+typedef struct _Options
+{
+    gboolean warm;
+    gchar* output_name;
+    Output output;
+    gboolean mlock;
+    gchar* input_name;
+    gchar* flip_name;
+    gchar* variant;
+    gint local_size;
+    gint stack;
+    gboolean cl_profile;
+    gchar* cl_trace;
+    gboolean perf;
+    gchar* pages_name;
+    BenchPages pages;
+    gboolean populate;
+    gchar* producer_cpus_name;
+    gchar* worker_cpus_name;
+    gint mem_node = -1;
+    gchar* source_path;
+    gint readahead = 8;
+} Options;
+
+Options options;
+
+/* CPU and NUMA placement, see place_thread() */
+static BenchTopology* topology;
+static GArray* producer_cpus;
+static GArray* worker_cpus;
+static gint next_worker;
+
+/* raw frame stack on disk and the time of one cold read, see init_input() */
+static BenchSource* source;
+static gint64 source_read_ns;
+
+static const GOptionEntry entries[] = {
+    { "warm", 'w', 0, G_OPTION_ARG_NONE, &options.warm, "Build the graph once and reuse it for every run", NULL },
+    { "output", 'o', 0, G_OPTION_ARG_STRING, &options.output_name, "Output buffer for memory-out, a fresh g_malloc per run (default), a reused arena or pinned OpenCL host memory", "malloc|arena|pinned" },
+    { "input", 'i', 0, G_OPTION_ARG_STRING, &options.input_name, "Placement of the memory-in data, all runs every placement one after another", "host|device|pinned|use-host-ptr|all" },
+    { "mlock", 'l', 0, G_OPTION_ARG_NONE, &options.mlock, "Lock the output arena into memory", NULL },
+    { "flip", 'f', 0, G_OPTION_ARG_STRING, &options.flip_name, "Flip task, the stock one of ufo-filters (default) or the in-tree fastflip, all runs both in the same graph layout", "flip|fastflip|all" },
+    { "variant", 0, 0, G_OPTION_ARG_STRING, &options.variant, "Kernel variant of fastflip", "scalar|vec4|vec16" },
+    { "local-size", 0, 0, G_OPTION_ARG_INT, &options.local_size, "Work-group size of fastflip along a row, 0 lets the driver choose", "N" },
+    { "cl-profile", 0, 0, G_OPTION_ARG_NONE, &options.cl_profile, "Profile every OpenCL command of the graph and break the runs down into transfers, kernels and idle time", NULL },
+    { "cl-trace", 0, 0, G_OPTION_ARG_FILENAME, &options.cl_trace, "Write a Chrome trace of all profiled runs, implies --cl-profile", "FILE" },
+    { "pages", 0, 0, G_OPTION_ARG_STRING, &options.pages_name, "Run again with the host memory of memory-in and memory-out on an arena of these pages, compared with a 4K arena set up the same way and with the default allocation", "4k|thp|2m|1g" },
+    { "populate", 0, 0, G_OPTION_ARG_NONE, &options.populate, "Fault the arenas in when they are created", NULL },
+    { "producer-cpus", 0, 0, G_OPTION_ARG_STRING, &options.producer_cpus_name, "Pin the main thread, which fills and hands over the frames, to these CPUs", "LIST" },
+    { "worker-cpus", 0, 0, G_OPTION_ARG_STRING, &options.worker_cpus_name, "Pin the scheduler and OpenCL driver threads one by one to these CPUs", "LIST" },
+    { "mem-node", 0, 0, G_OPTION_ARG_INT, &options.mem_node, "Bind the host buffers and the memory of all threads to a NUMA node", "NODE" },
+    { "source", 0, 0, G_OPTION_ARG_FILENAME, &options.source_path, "Take the frames from a raw frame stack, host input is read from the mapping without a copy, the other placements are filled from it", "FILE" },
+    { "readahead", 0, 0, G_OPTION_ARG_INT, &options.readahead, "Frames the kernel reads ahead of the source (default 8)", "N" },
+    { "perf", 0, 0, G_OPTION_ARG_NONE, &options.perf, "Count cycles, instructions, LLC and dTLB misses and context switches of every thread", NULL },
+    { "stack", 'k', 0, G_OPTION_ARG_INT, &options.stack, "Frames per kernel launch, memory-in hands the flip stacks of K frames instead of single frames (default 1)", "K" },
+    { NULL }
+};
+
 static void
 check_error(GError** error)
 {
@@ -32,6 +157,99 @@ check_error(GError** error)
 
 CustomData data;
 
+/* Frames per second the disk delivers, from the cold read */
+static gdouble
+source_disk_rate()
+{
+    return source_read_ns > 0 ? source->size / (source_read_ns / 1e9) / bench_geometry_frame_size(&data.geometry) : 0;
+}
+
+/* The graph processes frames at fps from the page cache, the lower of that
+ * and the disk rate is what real data gets through. label tells the runs of
+ * a graph apart */
+static void
+set_source_values(BenchReport* report, const BenchConfig* config, const gchar* label, gdouble fps)
+{
+    const gchar* names[] = { "Disk Rate", "Compute Rate", "Real Data Rate" };
+    gdouble disk = source_disk_rate();
+    gdouble rates[] = { disk, fps, MIN(disk, fps) };
+
+    for (guint i = 0; i < G_N_ELEMENTS(names); i++)
+    {
+        gchar* base = g_strconcat(names[i], label, NULL);
+        gchar* name = bench_config_get_metric_name(config, base, &data.geometry);
+
+        bench_report_set_value(report, name, rates[i], "frames/s");
+        g_free(name);
+        g_free(base);
+    }
+}
+
+/* Runs in every thread started after main() placed itself. The scheduler
+ * and the OpenCL drivers start theirs whenever they like, each takes the next
+ * worker CPU, or gets every CPU back from the pinned main thread */
+static void
+place_thread(gpointer user_data)
+{
+    (void)user_data;
+
+    if (worker_cpus != NULL)
+    {
+        guint index = (guint)g_atomic_int_add(&next_worker, 1);
+        gint cpu = g_array_index(worker_cpus, gint, index % worker_cpus->len);
+
+        if (!bench_pin_thread(cpu))
+            g_warning("could not pin worker %u to cpu %d: %s", index, cpu, g_strerror(errno));
+    }
+    else
+        bench_pin_thread_cpus(topology->cpus, topology->n_cpus);
+}
+
+static GArray*
+parse_cpus(const gchar* list)
+{
+    GArray* cpus = bench_cpulist_parse(list);
+
+    if (cpus != NULL && cpus->len == 0)
+    {
+        g_array_unref(cpus);
+        return NULL;
+    }
+
+    return cpus;
+}
+
+static void
+set_cpus_info(BenchReport* report, const gchar* key, GArray* cpus)
+{
+    if (cpus == NULL)
+        return;
+
+    gchar* list = bench_cpulist_to_string((const gint*)(gpointer)cpus->data, cpus->len);
+    bench_report_set_info(report, key, list);
+    g_free(list);
+}
+
+static BenchArena*
+new_arena(gsize size)
+{
+    GError* error = NULL;
+    BenchArena* arena = bench_arena_new(size, data.pages, options.populate, options.mem_node, &error);
+
+    check_error(&error);
+    data.arena_pages = arena->pages;
+
+    return arena;
+}
+
+/* memory-in converts to float, so memory-out always writes 4 bytes per pixel */
+void set_geometry(const BenchGeometry* geometry)
+{
+    data.geometry = *geometry;
+    data.input_size = bench_geometry_batch_size(geometry);
+    data.output_size = (gsize)geometry->width * geometry->height * geometry->number * sizeof(gfloat);
+}
+
 void init()
 {
     /* Initialize cumstom data structure */
@@ -46,10 +264,97 @@ void init()
         exit(-1);
     }
 
+    GList* queues = ufo_resources_get_cmd_queues(data.res);
+    data.queue = (cl_command_queue)queues->data;
+    g_list_free(queues);
+}
+
+/* Places the memory-in data, host and pinned are handed over as host pointers,
+ * device and use-host-ptr as cl_mem. With a source the first batch of the
+ * stack fills them, host input walks through the whole stack instead */
+void init_input(Input input)
+{
     cl_context ctx = (cl_context)ufo_resources_get_context(data.res);
+    gsize size = data.input_size;
+    cl_int error2 = CL_SUCCESS;
+    const guint8* fill = NULL;
+
+    if (source != NULL)
+    {
+        GError* error = NULL;
+
+        bench_source_set_frame_size(source, bench_geometry_frame_size(&data.geometry), &error);
+        check_error(&error);
+        if (source->n_frames < data.geometry.number)
+        {
+            g_error("%s holds %u frames, fewer than a batch", options.source_path, source->n_frames);
+            exit(-1);
+        }
+        if (input != INPUT_HOST)
+            fill = bench_source_next(source, data.geometry.number);
+    }
+
+    switch (input)
+    {
+    case INPUT_HOST:
+        if (source != NULL)
+        {
+            /* see run_graph() */
+            data.input_source = TRUE;
+        }
+        else if (data.arena_pass)
+        {
+            data.input_arena = new_arena(size);
+            data.input_host = data.input_arena->data;
+        }
+        else
+            data.input_host = g_malloc0(size);
+        data.input = data.input_host;
+        data.input_location = 0;
+        break;
+    case INPUT_DEVICE:
+        /* the host has no access later on, it can only be filled here */
+        data.buffer = clCreateBuffer(ctx, CL_MEM_HOST_NO_ACCESS | (fill != NULL ? CL_MEM_COPY_HOST_PTR : 0), size,
+            (gpointer)fill, &error2);
+        data.input = data.buffer;
+        data.input_location = 1;
+        break;
+    case INPUT_PINNED:
+        data.buffer = clCreateBuffer(ctx, CL_MEM_ALLOC_HOST_PTR | CL_MEM_READ_ONLY, size, NULL, &error2);
+        if (error2 == CL_SUCCESS)
+            data.input = clEnqueueMapBuffer(data.queue, data.buffer, CL_TRUE, CL_MAP_WRITE, 0, size, 0, NULL, NULL, &error2);
+        if (error2 == CL_SUCCESS && fill != NULL)
+            memcpy(data.input, fill, size);
+        else if (error2 == CL_SUCCESS)
+            memset(data.input, 0, size);
+        data.input_location = 0;
+        break;
+    case INPUT_USE_HOST_PTR:
+        /* page aligned, which is what implementations want for zero copy */
+        if (data.arena_pass)
+        {
+            data.input_arena = new_arena(size);
+            data.input_host = data.input_arena->data;
+        }
+        else
+            data.input_host = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data.input_host == MAP_FAILED)
+        {
+            g_error("input: %s", g_strerror(errno));
+            exit(-1);
+        }
+        if (fill != NULL)
+            memcpy(data.input_host, fill, size);
+        else
+            memset(data.input_host, 0, size);
+        data.buffer = clCreateBuffer(ctx, CL_MEM_USE_HOST_PTR | CL_MEM_READ_ONLY, size, data.input_host, &error2);
+        data.input = data.buffer;
+        data.input_location = 1;
+        break;
+    default:
+        g_assert_not_reached();
+    }
 
-    cl_int error2;
-    data.buffer = clCreateBuffer(ctx, CL_MEM_HOST_NO_ACCESS, WIDTH * HEIGHT * 4 * NUMBER, NULL, &error2);
     if (error2 != 0)
     {
         g_error("buffer: %d", error2);
@@ -57,13 +362,126 @@ void init()
     }
 }
 
+void free_input(Input input)
+{
+    gsize size = data.input_size;
+
+    switch (input)
+    {
+    case INPUT_HOST:
+        if (data.input_arena == NULL)
+            g_free(data.input_host);
+        break;
+    case INPUT_PINNED:
+        clEnqueueUnmapMemObject(data.queue, data.buffer, data.input, 0, NULL, NULL);
+        clFinish(data.queue);
+        clReleaseMemObject(data.buffer);
+        break;
+    case INPUT_USE_HOST_PTR:
+        clReleaseMemObject(data.buffer);
+        if (data.input_arena == NULL)
+            munmap(data.input_host, size);
+        break;
+    default:
+        clReleaseMemObject(data.buffer);
+        break;
+    }
+
+    if (data.input_arena != NULL)
+        bench_arena_free(data.input_arena);
+
+    data.buffer = NULL;
+    data.input = NULL;
+    data.input_host = NULL;
+    data.input_arena = NULL;
+    data.input_source = FALSE;
+}
+
+/* Allocates the memory-out target once and faults it in, so runs only pay for
+ * the device to host transfer */
+void init_output()
+{
+    gsize size = data.output_size;
+
+    /* the arena pass reuses one arena for malloc as well */
+    if (options.output == OUTPUT_MALLOC && !data.arena_pass)
+        return;
+
+    if (options.output == OUTPUT_PINNED)
+    {
+        cl_context ctx = (cl_context)ufo_resources_get_context(data.res);
+        cl_int error;
+
+        data.output_mem = clCreateBuffer(ctx, CL_MEM_ALLOC_HOST_PTR | CL_MEM_READ_WRITE, size, NULL, &error);
+        if (error != CL_SUCCESS)
+        {
+            g_error("pinned buffer: %d", error);
+            exit(-1);
+        }
+
+        data.output = clEnqueueMapBuffer(data.queue, data.output_mem, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE,
+            0, size, 0, NULL, NULL, &error);
+        if (error != CL_SUCCESS)
+        {
+            g_error("map pinned buffer: %d", error);
+            exit(-1);
+        }
+    }
+    else if (data.arena_pass)
+    {
+        data.output_arena = new_arena(size);
+        data.output = data.output_arena->data;
+    }
+    else
+    {
+        data.output = g_malloc(size);
+    }
+
+    memset(data.output, 0, size);
+
+    if (options.mlock)
+    {
+        data.output_locked = mlock(data.output, size) == 0;
+        if (!data.output_locked)
+            g_warning("mlock of the output arena failed: %s", g_strerror(errno));
+    }
+}
+
+void free_output()
+{
+    gsize size = data.output_size;
+
+    if (data.output_locked)
+        munlock(data.output, size);
+
+    if (data.output_mem != NULL)
+    {
+        clEnqueueUnmapMemObject(data.queue, data.output_mem, data.output, 0, NULL, NULL);
+        clFinish(data.queue);
+        clReleaseMemObject(data.output_mem);
+    }
+    else if (data.output_arena != NULL)
+    {
+        bench_arena_free(data.output_arena);
+    }
+    else
+    {
+        g_free(data.output);
+    }
+
+    data.output = NULL;
+    data.output_mem = NULL;
+    data.output_arena = NULL;
+    data.output_locked = FALSE;
+}
+
 void free()
 {
-    clReleaseMemObject(data.buffer);
     g_object_unref(data.res);
 }
 
-gint test()
+/* Loads the plugins, creates the tasks and the scheduler and connects them */
+void build_graph()
 {
     GError* error = NULL;
 
@@ -78,10 +496,10 @@ gint test()
         g_error("memory-in: %s", (error)->message);
         exit(-1);
     }
-    data.flip = ufo_plugin_manager_get_task(data.manager, "flip", &error);
+    data.flip = ufo_plugin_manager_get_task(data.manager, flip_names[data.flip_task], &error);
     if (error != NULL)
     {
-        g_error("flip: %s", (error)->message);
+        g_error("%s: %s", flip_names[data.flip_task], (error)->message);
         exit(-1);
     }
     data.memory_out = ufo_plugin_manager_get_task(data.manager, "memory-out", &error);
@@ -95,46 +513,103 @@ gint test()
 
     ufo_base_scheduler_set_resources(data.scheduler, data.res);
 
-    /* Configure memory-in */
+    /* Configure memory-in, a stack of K frames is contiguous in the batch so
+     * it is handed over as one frame of K times the height. Both flip tasks
+     * work on rows, so every stack costs one launch and one handoff */
     g_object_set(G_OBJECT(data.memory_in),
-        "pointer", data.buffer,
-        "width", WIDTH,
-        "height", HEIGHT,
-        "number", NUMBER,
-        "bitdepth", sizeof(guint32) * 8,
-        "memory-location", 1,
+        "width", data.geometry.width,
+        "height", data.geometry.height * options.stack,
+        "number", data.geometry.number / options.stack,
+        "bitdepth", bench_format_get_bpp(data.geometry.format) * 8,
         NULL);
 
     /* Configure flip */
-    g_object_set(G_OBJECT(data.flip),
-        "direction", 1,
+    if (data.flip_task == FLIP_STOCK)
+    {
+        /* horizontal like fastflip, looked up by nick since the numbers of
+         * the ufo-filters enum are not ours to rely on */
+        GParamSpec* pspec = g_object_class_find_property(G_OBJECT_GET_CLASS(data.flip), "direction");
+        GEnumValue* direction = pspec != NULL && G_IS_PARAM_SPEC_ENUM(pspec) ?
+            g_enum_get_value_by_nick(G_PARAM_SPEC_ENUM(pspec)->enum_class, "horizontal") : NULL;
+        if (direction == NULL)
+        {
+            g_error("flip: no horizontal direction");
+            exit(-1);
+        }
+
+        g_object_set(G_OBJECT(data.flip),
+            "direction", direction->value,
+            NULL);
+    }
+    else
+    {
+        /* the variants are looked up by nick, the task header is not ours to include */
+        GParamSpec* pspec = g_object_class_find_property(G_OBJECT_GET_CLASS(data.flip), "variant");
+        GEnumValue* variant = g_enum_get_value_by_nick(G_PARAM_SPEC_ENUM(pspec)->enum_class, options.variant);
+        if (variant == NULL)
+        {
+            g_error("fastflip: unknown variant %s", options.variant);
+            exit(-1);
+        }
+
+        g_object_set(G_OBJECT(data.flip),
+            "variant", variant->value,
+            "local-size", (guint)options.local_size,
+            NULL);
+    }
+
+    /* Connect tasks in graph */
+    ufo_task_graph_connect_nodes(data.graph, data.memory_in, data.flip);
+    ufo_task_graph_connect_nodes(data.graph, data.flip, data.memory_out);
+}
+
+/* Points the graph at the input and output of this run and runs it, returns
+ * the time of the scheduler run alone */
+gint64 run_graph()
+{
+    GError* error = NULL;
+
+    /* the readahead of the following batch overlaps with this run */
+    if (data.input_source)
+        data.input = (gpointer)bench_source_next(source, data.geometry.number);
+
+    /* Configure memory-in */
+    g_object_set(G_OBJECT(data.memory_in),
+        "pointer", data.input,
+        "memory-location", data.input_location,
         NULL);
 
-    gpointer outBuffer = g_malloc(WIDTH * HEIGHT * NUMBER * 4);
+    gboolean fresh = options.output == OUTPUT_MALLOC && data.output == NULL;
+    gpointer outBuffer = fresh ? g_malloc(data.output_size) : data.output;
     /* Configure memory-out */
     g_object_set(G_OBJECT(data.memory_out),
         "pointer", outBuffer,
-        "max-size", WIDTH * HEIGHT * NUMBER * 4,
+        "max-size", data.output_size,
         NULL);
 
-    /* Connect tasks in graph */
-    ufo_task_graph_connect_nodes(data.graph, data.memory_in, data.flip);
-    ufo_task_graph_connect_nodes(data.graph, data.flip, data.memory_out);
-
     /* Run graph */
-    auto t1 = std::chrono::high_resolution_clock::now();
+    profile_begin();
+    gint64 t1 = bench_now_ns();
 
     ufo_base_scheduler_run(data.scheduler, data.graph, &error);
 
-    auto t2 = std::chrono::high_resolution_clock::now();
+    gint64 t2 = bench_now_ns();
+    if (profile_is_enabled())
+        profile_end(t1, t2, &data.profile);
 
     if (error != NULL)
     {
         g_error("run: %s", (error)->message);
         exit(-1);
     }
-    g_free(outBuffer);
+    if (fresh)
+        g_free(outBuffer);
+
+    return t2 - t1;
+}
 
+void destroy_graph()
+{
     /* Destroy all objects */
     g_object_unref(data.memory_in);
     g_object_unref(data.flip);
@@ -142,40 +617,410 @@ gint test()
     g_object_unref(data.graph);
     g_object_unref(data.scheduler);
     g_object_unref(data.manager);
+    data.graph = NULL;
+}
+
+/* Cold runs build and destroy the graph around every run, the whole is
+ * recorded as "cold". Warm runs keep the graph of the first run, which is
+ * the only cold one then and not part of the warm samples */
+gint64 test(gpointer user_data)
+{
+    (void)user_data;
+
+    gint64 t0 = bench_now_ns();
+    gboolean cold = data.graph == NULL;
+
+    if (cold)
+        build_graph();
 
-    return std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+    gint64 run = run_graph();
+
+    if (!options.warm)
+        destroy_graph();
+
+    if (cold)
+        bench_recorder_add(data.cold, bench_now_ns() - t0);
+
+    if (cold && options.warm)
+        run = run_graph();
+
+    if (profile_is_enabled())
+    {
+        for (gint i = 0; i < N_PROFILE_PHASES; i++)
+            bench_recorder_add(data.phases[i], data.profile.phases[i]);
+        bench_recorder_add(data.idle, data.profile.idle);
+    }
+
+    return run;
 }
 
 int
 main(int argc, char* argv[])
 {
-    gint count = 3600;
-    glong sum = 0;
+    BenchConfig config;
+    GError* error = NULL;
+
+    bench_config_init(&config, WIDTH, HEIGHT, NUMBER, BENCH_FORMAT_RGBA);
+    if (!bench_config_parse(&config, "- UFO flip benchmark", entries, &argc, &argv, &error))
+    {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+
+    if (options.output_name == NULL || g_strcmp0(options.output_name, "malloc") == 0)
+        options.output = OUTPUT_MALLOC;
+    else if (g_strcmp0(options.output_name, "arena") == 0)
+        options.output = OUTPUT_ARENA;
+    else if (g_strcmp0(options.output_name, "pinned") == 0)
+        options.output = OUTPUT_PINNED;
+    else
+    {
+        g_printerr("unknown output %s\n", options.output_name);
+        return 1;
+    }
 
+    /* the device placement is what the harness always used */
+    gint first_input = INPUT_DEVICE, last_input = INPUT_DEVICE;
+    if (g_strcmp0(options.input_name, "all") == 0)
+    {
+        first_input = 0;
+        last_input = N_INPUTS - 1;
+    }
+    else if (options.input_name != NULL)
+    {
+        for (first_input = 0; first_input < N_INPUTS; first_input++)
+        {
+            if (g_strcmp0(options.input_name, input_names[first_input]) == 0)
+                break;
+        }
+        if (first_input == N_INPUTS)
+        {
+            g_printerr("unknown input %s\n", options.input_name);
+            return 1;
+        }
+        last_input = first_input;
+    }
+    gint n_inputs = last_input - first_input + 1;
+
+    gint first_flip = FLIP_STOCK, last_flip = FLIP_STOCK;
+    if (g_strcmp0(options.flip_name, "all") == 0)
+    {
+        first_flip = 0;
+        last_flip = N_FLIPS - 1;
+    }
+    else if (options.flip_name != NULL)
+    {
+        for (first_flip = 0; first_flip < N_FLIPS; first_flip++)
+        {
+            if (g_strcmp0(options.flip_name, flip_names[first_flip]) == 0)
+                break;
+        }
+        if (first_flip == N_FLIPS)
+        {
+            g_printerr("unknown flip %s\n", options.flip_name);
+            return 1;
+        }
+        last_flip = first_flip;
+    }
+    gint n_flips = last_flip - first_flip + 1;
+
+    if (options.variant == NULL)
+        options.variant = g_strdup("vec4");
+    if (options.local_size < 0 || options.local_size > 1024)
+    {
+        g_printerr("local size must be within 0 and 1024\n");
+        return 1;
+    }
+
+    if (options.pages_name != NULL && !bench_pages_from_string(options.pages_name, &options.pages))
+    {
+        g_printerr("unknown pages %s\n", options.pages_name);
+        return 1;
+    }
+
+    if (options.producer_cpus_name != NULL && (producer_cpus = parse_cpus(options.producer_cpus_name)) == NULL)
+    {
+        g_printerr("invalid cpu list %s\n", options.producer_cpus_name);
+        return 1;
+    }
+    if (options.worker_cpus_name != NULL && (worker_cpus = parse_cpus(options.worker_cpus_name)) == NULL)
+    {
+        g_printerr("invalid cpu list %s\n", options.worker_cpus_name);
+        return 1;
+    }
+    /* host input would come from the source in both passes */
+    if (options.source_path != NULL && options.pages_name != NULL)
+    {
+        g_printerr("--source can not be combined with --pages\n");
+        return 1;
+    }
+    if (options.readahead < 0)
+    {
+        g_printerr("readahead must not be negative\n");
+        return 1;
+    }
+    if (options.mem_node < -1)
+    {
+        g_printerr("mem-node must not be negative\n");
+        return 1;
+    }
+
+    if (options.stack == 0)
+        options.stack = 1;
+    if (options.stack < 0)
+    {
+        g_printerr("stack must be positive\n");
+        return 1;
+    }
+
+    guint n_geometries = bench_config_get_n_geometries(&config);
+    for (guint g = 0; g < n_geometries; g++)
+    {
+        if (bench_config_get_geometry(&config, g)->number % options.stack != 0)
+        {
+            g_printerr("stack %d does not divide the number of frames\n", options.stack);
+            return 1;
+        }
+    }
+
+    BenchReport* report = bench_report_new("ufo");
+    /* what a stored report was measured against */
+    bench_report_set_info(report, "ufo-core", UFO_LIBRARY_VERSION);
+    if (n_geometries == 1)
+        bench_report_set_geometry(report, bench_config_get_geometry(&config, 0));
+    else
+        bench_report_set_info_int(report, "sweep", n_geometries);
+    bench_report_set_info(report, "graph", options.warm ? "warm" : "cold");
+    bench_report_set_info(report, "output", options.output_name != NULL ? options.output_name : "malloc");
+    bench_report_set_info(report, "input", n_inputs > 1 ? "all" : input_names[first_input]);
+    bench_report_set_info(report, "flip", n_flips > 1 ? "all" : flip_names[first_flip]);
+    bench_report_set_info_int(report, "stack", options.stack);
+    bench_report_set_info(report, "pages", options.pages_name != NULL ? options.pages_name : "default");
+    if (options.pages_name != NULL)
+        bench_report_set_info(report, "populate", options.populate ? "yes" : "no");
+    if (last_flip == FLIP_FAST)
+    {
+        bench_report_set_info(report, "variant", options.variant);
+        bench_report_set_info_int(report, "local-size", options.local_size);
+    }
+
+    if (options.cl_profile || options.cl_trace != NULL)
+    {
+        profile_enable(options.cl_trace != NULL);
+        bench_report_set_info(report, "cl-profile", options.cl_trace != NULL ? "trace" : "yes");
+    }
+
+    /* the scheduler threads get their counters as they start */
+    if (options.perf)
+    {
+        config.perf = bench_perf_new(&error);
+        check_error(&error);
+    }
+    bench_report_set_info(report, "perf", options.perf ? "yes" : "no");
+
+    /* placed before init(), the drivers start their threads with the context.
+     * The policy of the main thread covers every host buffer it faults in */
+    topology = bench_topology_new();
+    if (producer_cpus != NULL || worker_cpus != NULL)
+        bench_thread_add_start_hook(place_thread, NULL);
+    if (producer_cpus != NULL && !bench_pin_thread_cpus((const gint*)(gpointer)producer_cpus->data, producer_cpus->len))
+        g_warning("could not pin the main thread: %s", g_strerror(errno));
+    if (options.mem_node >= 0 && !bench_bind_thread_memory(options.mem_node))
+        g_warning("could not bind to node %d: %s", options.mem_node, g_strerror(errno));
+    bench_topology_report(topology, report);
+    set_cpus_info(report, "producer-cpus", producer_cpus);
+    set_cpus_info(report, "worker-cpus", worker_cpus);
+    if (options.mem_node >= 0)
+        bench_report_set_info_int(report, "mem-node", options.mem_node);
+
+    /* read once from the disk, the runs then find the stack in the page
+     * cache as far as it fits */
+    if (options.source_path != NULL)
+    {
+        source = bench_source_new(options.source_path, options.readahead, &error);
+        check_error(&error);
+        bench_source_set_frame_size(source, bench_geometry_frame_size(bench_config_get_geometry(&config, 0)), &error);
+        check_error(&error);
+        source_read_ns = bench_source_read_cold(source);
+        bench_report_set_info(report, "source", options.source_path);
+        bench_report_set_info_int(report, "readahead", options.readahead);
+        bench_report_set_bandwidth(report, "Disk Bandwidth", source->size, source_read_ns);
+    }
+
+    bench_calibrate(&config, report);
     init();
-    gint* values = new gint[count];
-    gint max = 0;
-    for (gint i = 0; i < count; i++)
+
+    for (guint g = 0; g < n_geometries; g++)
     {
-        values[i] = test();
-        sum += values[i];
-        max = std::max(max, values[i]);
+        const BenchGeometry* geometry = bench_config_get_geometry(&config, g);
+
+        set_geometry(geometry);
+        /* the arena passes repeat everything with host memory on arenas, one
+         * of 4K set up the same way and one of the requested pages. The
+         * default pass allocates fresh output per run, so only the 4K arena
+         * tells the page size apart from reuse and prefaulting */
+        gint n_arena_passes = options.pages_name == NULL ? 0 : options.pages == BENCH_PAGES_4K ? 1 : 2;
+        for (gint pass = 0; pass <= n_arena_passes; pass++)
+        {
+            data.arena_pass = pass > 0;
+            data.pages = pass == n_arena_passes ? options.pages : BENCH_PAGES_4K;
+
+            /* the default pass keeps the plain names, baselines stay comparable */
+            gchar* suffix = data.arena_pass ? g_strdup_printf(" %s", bench_pages_to_string(data.pages)) : g_strdup("");
+
+            init_output();
+            bench_report_set_info(report, "output-locked", data.output_locked ? "yes" : "no");
+
+            gchar* cold_base = g_strconcat("cold", suffix, NULL);
+            gchar* cold = bench_config_get_metric_name(&config, cold_base, geometry);
+            data.cold = bench_report_add_metric(report, cold, config.iterations * n_inputs * n_flips);
+            g_free(cold);
+            g_free(cold_base);
+
+            for (gint flip = first_flip; flip <= last_flip; flip++)
+            {
+                data.flip_task = (Flip)flip;
+
+                for (gint input = first_input; input <= last_input; input++)
+                {
+                    GString* base = g_string_new(options.warm ? "warm" : "run");
+                    GString* value_base = g_string_new("Bandwidth");
+                    if (n_flips > 1)
+                    {
+                        g_string_append_printf(base, " %s", flip_names[flip]);
+                        g_string_append_printf(value_base, " %s", flip_names[flip]);
+                    }
+                    if (n_inputs > 1)
+                        g_string_append_printf(base, " %s", input_names[input]);
+                    g_string_append_printf(value_base, " %s", input_names[input]);
+
+                    gchar* plain = bench_config_get_metric_name(&config, base->str, geometry);
+                    gchar* small_base = g_strdup_printf("%s %s", base->str, bench_pages_to_string(BENCH_PAGES_4K));
+                    gchar* small = bench_config_get_metric_name(&config, small_base, geometry);
+                    g_string_append(base, suffix);
+                    g_string_append(value_base, suffix);
+
+                    gchar* metric = bench_config_get_metric_name(&config, base->str, geometry);
+                    BenchRecorder* run = bench_report_add_metric(report, metric, config.iterations);
+                    BenchStats stats;
+
+                    if (profile_is_enabled())
+                    {
+                        for (gint i = 0; i < N_PROFILE_PHASES; i++)
+                        {
+                            gchar* phase_base = g_strdup_printf("%s cl %s", base->str, profile_phase_names[i]);
+                            gchar* phase = bench_config_get_metric_name(&config, phase_base, geometry);
+                            data.phases[i] = bench_report_add_metric(report, phase, config.iterations);
+                            g_free(phase);
+                            g_free(phase_base);
+                        }
+
+                        gchar* idle_base = g_strdup_printf("%s cl idle", base->str);
+                        gchar* idle = bench_config_get_metric_name(&config, idle_base, geometry);
+                        data.idle = bench_report_add_metric(report, idle, config.iterations);
+                        g_free(idle);
+                        g_free(idle_base);
+                    }
+
+                    init_input((Input)input);
+                    bench_run(&config, run, test, NULL);
+                    free_input((Input)input);
+
+                    /* effective rate of moving the batch in and out of the graph */
+                    bench_recorder_compute_stats(run, &stats);
+                    gchar* value = bench_config_get_metric_name(&config, value_base->str, geometry);
+                    bench_report_set_bandwidth(report, value, data.input_size + data.output_size, stats.p50);
+                    if (source != NULL && input == INPUT_HOST)
+                    {
+                        gdouble fps = stats.p50 > 0 ? geometry->number * 1e9 / stats.p50 : 0;
+
+                        set_source_values(report, &config, value_base->str + strlen("Bandwidth"), fps);
+                        if (n_geometries == 1 && n_flips == 1)
+                            bench_report_set_info(report, "bound", source_disk_rate() < fps ? "disk" : "compute");
+                    }
+                    if (config.perf != NULL)
+                        bench_perf_report(config.perf, report, metric, data.input_size + data.output_size);
+                    bench_baseline_compare(config.baseline, report, run, geometry);
+
+                    /* same flip and placement on default allocations and on the
+                     * 4K arena, run in the passes before */
+                    if (data.arena_pass)
+                    {
+                        BenchStats default_stats;
+                        gchar* versus_base = g_strdup_printf("%s vs default", value_base->str);
+                        gchar* versus = bench_config_get_metric_name(&config, versus_base, geometry);
+
+                        bench_recorder_compute_stats(bench_report_get_metric(report, plain), &default_stats);
+                        bench_report_set_value(report, versus, stats.p50 > 0 ? default_stats.p50 / stats.p50 : 0, "x");
+                        g_free(versus);
+                        g_free(versus_base);
+                    }
+                    if (data.arena_pass && data.pages != BENCH_PAGES_4K)
+                    {
+                        BenchStats small_stats;
+                        gchar* speedup_base = g_strdup_printf("%s speedup", value_base->str);
+                        gchar* speedup = bench_config_get_metric_name(&config, speedup_base, geometry);
+
+                        bench_recorder_compute_stats(bench_report_get_metric(report, small), &small_stats);
+                        bench_report_set_value(report, speedup, stats.p50 > 0 ? small_stats.p50 / stats.p50 : 0, "x");
+                        g_free(speedup);
+                        g_free(speedup_base);
+                    }
+
+                    g_free(value);
+                    g_free(small);
+                    g_free(small_base);
+                    g_free(plain);
+                    g_free(metric);
+                    g_string_free(value_base, TRUE);
+                    g_string_free(base, TRUE);
+                }
+
+                /* the graph is configured for one geometry and flip task */
+                if (data.graph != NULL)
+                    destroy_graph();
+            }
+
+            free_output();
+            g_free(suffix);
+        }
     }
+
+    /* what the kernel gave, hugetlb falls back to THP without reserved pages */
+    if (options.pages_name != NULL)
+        bench_report_set_info(report, "arena-pages", bench_pages_to_string(data.arena_pages));
+
     free();
 
-    gdouble mean = (gdouble)sum / count;
+    bench_finish(&config, report, &error);
+    check_error(&error);
 
-    gdouble sum2 = 0;
-    for (gint i = 0; i < count; i++)
+    if (options.cl_trace != NULL)
     {
-        sum2 += std::pow(values[i]- mean, 2);
+        profile_write_trace(options.cl_trace, &error);
+        check_error(&error);
     }
+    profile_clear();
 
-    gdouble stdDev = std::sqrt(sum2 / (count - 1));
-    
-    std::cout << "Mean: " << mean << " ms" <<std::endl;
-    std::cout << "Standard Deviation: " << stdDev << " ms" << std::endl;
-    std::cout << "Max: " << max << " ms" <<std::endl;
+    bench_report_free(report);
+    bench_config_clear(&config);
+    g_free(options.output_name);
+    g_free(options.input_name);
+    g_free(options.flip_name);
+    g_free(options.variant);
+    g_free(options.cl_trace);
+    if (producer_cpus != NULL || worker_cpus != NULL)
+        bench_thread_remove_start_hook(place_thread, NULL);
+    bench_topology_free(topology);
+    if (producer_cpus != NULL)
+        g_array_unref(producer_cpus);
+    if (worker_cpus != NULL)
+        g_array_unref(worker_cpus);
+    if (source != NULL)
+        bench_source_free(source);
+    g_free(options.source_path);
+    g_free(options.producer_cpus_name);
+    g_free(options.worker_cpus_name);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,336 @@
+#define CL_USE_DEPRECATED_OPENCL_1_2_APIS
+
+#include "profile.h"
+
+#include <benchcore/bench.h>
+#include <CL/cl.h>
+#include <dlfcn.h>
+#include <string.h>
+#include <atomic>
+
+const gchar* profile_phase_names[N_PROFILE_PHASES] = { "write", "kernel", "read", "copy", "map" };
+
+typedef struct _Command
+{
+    ProfilePhase phase;
+    cl_command_queue queue;
+    cl_event event;
+    gint64 enqueued;
+} Command;
+
+/* phase is -1 for the scheduler run itself, which goes on its own track */
+typedef struct _Slice
+{
+    gint phase;
+    guint track;
+    gint64 start;
+    gint64 stop;
+} Slice;
+
+static struct
+{
+    std::atomic<bool> enabled;
+    std::atomic<bool> recording;
+    gboolean trace;
+
+    GMutex lock;
+    GArray* commands;
+
+    GArray* slices;
+    GPtrArray* queues;
+} profile;
+
+/* The OpenCL implementation behind our interposed entry points */
+#define REAL(name) static decltype(&name) real = (decltype(&name))dlsym(RTLD_NEXT, #name)
+
+void
+profile_enable(gboolean trace)
+{
+    profile.commands = g_array_new(FALSE, FALSE, sizeof(Command));
+    profile.slices = g_array_new(FALSE, FALSE, sizeof(Slice));
+    profile.queues = g_ptr_array_new();
+    profile.trace = trace;
+    profile.enabled = true;
+}
+
+gboolean
+profile_is_enabled()
+{
+    return profile.enabled;
+}
+
+void
+profile_begin()
+{
+    profile.recording = profile.enabled.load();
+}
+
+/* Hands out our own event when the caller does not want one */
+static cl_event*
+profile_event(cl_event* event, cl_event* own)
+{
+    if (!profile.recording || event != NULL)
+        return event;
+
+    return own;
+}
+
+static void
+profile_record(ProfilePhase phase, cl_command_queue queue, cl_event* event, cl_event own, gint64 enqueued)
+{
+    /* recording started between the enqueue and here */
+    if (!profile.recording || (event == NULL && own == NULL))
+        return;
+
+    Command command = { phase, queue, own, enqueued };
+
+    if (event != NULL)
+    {
+        command.event = *event;
+        clRetainEvent(command.event);
+    }
+
+    g_mutex_lock(&profile.lock);
+    g_array_append_val(profile.commands, command);
+    g_mutex_unlock(&profile.lock);
+}
+
+static guint
+profile_get_track(cl_command_queue queue)
+{
+    guint index;
+
+    if (!g_ptr_array_find(profile.queues, queue, &index))
+    {
+        index = profile.queues->len;
+        g_ptr_array_add(profile.queues, queue);
+    }
+
+    /* track 0 is the scheduler run */
+    return index + 1;
+}
+
+static gint
+compare_slices(gconstpointer a, gconstpointer b)
+{
+    gint64 sa = ((const Slice*)a)->start, sb = ((const Slice*)b)->start;
+
+    return sa < sb ? -1 : sa > sb;
+}
+
+void
+profile_end(gint64 start, gint64 stop, ProfileRun* run)
+{
+    GArray* busy = g_array_new(FALSE, FALSE, sizeof(Slice));
+    gint64 offset = G_MININT64;
+
+    profile.recording = false;
+    memset(run, 0, sizeof(*run));
+
+    /* The device clock is unrelated to ours. Each command was queued after
+     * we took its enqueue time, so host minus queued is a lower bound of the
+     * offset between both clocks and the largest one is the closest */
+    for (guint i = 0; i < profile.commands->len; i++)
+    {
+        Command* command = &g_array_index(profile.commands, Command, i);
+        cl_ulong queued = 0, begin = 0, end = 0;
+
+        clWaitForEvents(1, &command->event);
+        clGetEventProfilingInfo(command->event, CL_PROFILING_COMMAND_QUEUED, sizeof(queued), &queued, NULL);
+        clGetEventProfilingInfo(command->event, CL_PROFILING_COMMAND_START, sizeof(begin), &begin, NULL);
+        clGetEventProfilingInfo(command->event, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL);
+        clReleaseEvent(command->event);
+
+        offset = MAX(offset, command->enqueued - (gint64)queued);
+
+        Slice slice = { command->phase, profile_get_track(command->queue), (gint64)begin, (gint64)end };
+        g_array_append_val(busy, slice);
+
+        run->phases[command->phase] += slice.stop - slice.start;
+        run->commands++;
+    }
+
+    g_array_set_size(profile.commands, 0);
+
+    for (guint i = 0; i < busy->len; i++)
+    {
+        g_array_index(busy, Slice, i).start += offset;
+        g_array_index(busy, Slice, i).stop += offset;
+    }
+
+    if (profile.trace)
+    {
+        Slice slice = { -1, 0, start, stop };
+
+        g_array_append_val(profile.slices, slice);
+        g_array_append_vals(profile.slices, busy->data, busy->len);
+    }
+
+    /* whatever part of the run is not covered by any command */
+    gint64 covered = 0, until = start;
+
+    g_array_sort(busy, compare_slices);
+    for (guint i = 0; i < busy->len; i++)
+    {
+        Slice* slice = &g_array_index(busy, Slice, i);
+        gint64 from = MAX(slice->start, until), to = MIN(slice->stop, stop);
+
+        if (to > from)
+        {
+            covered += to - from;
+            until = to;
+        }
+    }
+
+    run->idle = MAX(stop - start - covered, 0);
+
+    g_array_unref(busy);
+}
+
+gboolean
+profile_write_trace(const gchar* path, GError** error)
+{
+    GString* json = g_string_new("{\n  \"displayTimeUnit\": \"ns\",\n  \"traceEvents\": [\n");
+    gint64 origin = profile.slices->len > 0 ? g_array_index(profile.slices, Slice, 0).start : 0;
+
+    g_string_append(json, "    {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"scheduler\"}}");
+    for (guint i = 0; i < profile.queues->len; i++)
+        g_string_append_printf(json, ",\n    {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"queue %u\"}}", i + 1, i);
+
+    for (guint i = 0; i < profile.slices->len; i++)
+    {
+        Slice* slice = &g_array_index(profile.slices, Slice, i);
+
+        g_string_append_printf(json, ",\n    {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+            slice->phase < 0 ? "run" : profile_phase_names[slice->phase], slice->track,
+            (slice->start - origin) / 1e3, (slice->stop - slice->start) / 1e3);
+    }
+
+    g_string_append(json, "\n  ]\n}\n");
+
+    gboolean result = g_file_set_contents(path, json->str, json->len, error);
+
+    g_string_free(json, TRUE);
+
+    return result;
+}
+
+void
+profile_clear()
+{
+    if (!profile.enabled)
+        return;
+
+    g_array_unref(profile.commands);
+    g_array_unref(profile.slices);
+    g_ptr_array_unref(profile.queues);
+    profile.enabled = false;
+}
+
+/* Interposed OpenCL entry points, the executable exports them so they come
+ * before libOpenCL for every caller including libufo */
+
+cl_command_queue
+clCreateCommandQueue(cl_context context, cl_device_id device, cl_command_queue_properties properties, cl_int* errcode_ret)
+{
+    REAL(clCreateCommandQueue);
+
+    if (profile.enabled)
+        properties |= CL_QUEUE_PROFILING_ENABLE;
+
+    return real(context, device, properties, errcode_ret);
+}
+
+cl_int
+clEnqueueNDRangeKernel(cl_command_queue queue, cl_kernel kernel, cl_uint work_dim, const size_t* global_work_offset,
+    const size_t* global_work_size, const size_t* local_work_size, cl_uint n_events, const cl_event* wait_list, cl_event* event)
+{
+    REAL(clEnqueueNDRangeKernel);
+    cl_event own = NULL;
+    gint64 t = bench_now_ns();
+    cl_int error = real(queue, kernel, work_dim, global_work_offset, global_work_size, local_work_size,
+        n_events, wait_list, profile_event(event, &own));
+
+    if (error == CL_SUCCESS)
+        profile_record(PROFILE_KERNEL, queue, event, own, t);
+
+    return error;
+}
+
+cl_int
+clEnqueueWriteBuffer(cl_command_queue queue, cl_mem buffer, cl_bool blocking, size_t offset, size_t size,
+    const void* ptr, cl_uint n_events, const cl_event* wait_list, cl_event* event)
+{
+    REAL(clEnqueueWriteBuffer);
+    cl_event own = NULL;
+    gint64 t = bench_now_ns();
+    cl_int error = real(queue, buffer, blocking, offset, size, ptr, n_events, wait_list, profile_event(event, &own));
+
+    if (error == CL_SUCCESS)
+        profile_record(PROFILE_WRITE, queue, event, own, t);
+
+    return error;
+}
+
+cl_int
+clEnqueueReadBuffer(cl_command_queue queue, cl_mem buffer, cl_bool blocking, size_t offset, size_t size,
+    void* ptr, cl_uint n_events, const cl_event* wait_list, cl_event* event)
+{
+    REAL(clEnqueueReadBuffer);
+    cl_event own = NULL;
+    gint64 t = bench_now_ns();
+    cl_int error = real(queue, buffer, blocking, offset, size, ptr, n_events, wait_list, profile_event(event, &own));
+
+    if (error == CL_SUCCESS)
+        profile_record(PROFILE_READ, queue, event, own, t);
+
+    return error;
+}
+
+cl_int
+clEnqueueCopyBuffer(cl_command_queue queue, cl_mem src, cl_mem dst, size_t src_offset, size_t dst_offset, size_t size,
+    cl_uint n_events, const cl_event* wait_list, cl_event* event)
+{
+    REAL(clEnqueueCopyBuffer);
+    cl_event own = NULL;
+    gint64 t = bench_now_ns();
+    cl_int error = real(queue, src, dst, src_offset, dst_offset, size, n_events, wait_list, profile_event(event, &own));
+
+    if (error == CL_SUCCESS)
+        profile_record(PROFILE_COPY, queue, event, own, t);
+
+    return error;
+}
+
+void*
+clEnqueueMapBuffer(cl_command_queue queue, cl_mem buffer, cl_bool blocking, cl_map_flags flags, size_t offset,
+    size_t size, cl_uint n_events, const cl_event* wait_list, cl_event* event, cl_int* errcode_ret)
+{
+    REAL(clEnqueueMapBuffer);
+    cl_event own = NULL;
+    cl_int error = CL_SUCCESS;
+    gint64 t = bench_now_ns();
+    void* ptr = real(queue, buffer, blocking, flags, offset, size, n_events, wait_list, profile_event(event, &own), &error);
+
+    if (error == CL_SUCCESS)
+        profile_record(PROFILE_MAP, queue, event, own, t);
+    if (errcode_ret != NULL)
+        *errcode_ret = error;
+
+    return ptr;
+}
+
+cl_int
+clEnqueueUnmapMemObject(cl_command_queue queue, cl_mem memobj, void* ptr, cl_uint n_events,
+    const cl_event* wait_list, cl_event* event)
+{
+    REAL(clEnqueueUnmapMemObject);
+    cl_event own = NULL;
+    gint64 t = bench_now_ns();
+    cl_int error = real(queue, memobj, ptr, n_events, wait_list, profile_event(event, &own));
+
+    if (error == CL_SUCCESS)
+        profile_record(PROFILE_MAP, queue, event, own, t);
+
+    return error;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glib.h>
+
+typedef enum
+{
+    PROFILE_WRITE,
+    PROFILE_KERNEL,
+    PROFILE_READ,
+    PROFILE_COPY,
+    PROFILE_MAP,
+    N_PROFILE_PHASES,
+} ProfilePhase;
+
+extern const gchar* profile_phase_names[N_PROFILE_PHASES];
+
+/* Device time of one scheduler run per phase, idle is the part of the run
+ * in which no queue was busy */
+typedef struct _ProfileRun
+{
+    gint64 phases[N_PROFILE_PHASES];
+    gint64 idle;
+    guint commands;
+} ProfileRun;
+
+/* The OpenCL enqueue calls are interposed by the harness, which exports them
+ * with export_dynamic so libufo resolves to them. Enable before
+ * ufo_resources_new(), only queues created afterwards get
+ * CL_QUEUE_PROFILING_ENABLE. With trace every command is kept for
+ * profile_write_trace() */
+void profile_enable(gboolean trace);
+gboolean profile_is_enabled();
+
+/* Only commands enqueued between begin and end are recorded, end waits for
+ * them and fills run with the breakdown of [start, stop] */
+void profile_begin();
+void profile_end(gint64 start, gint64 stop, ProfileRun* run);
+
+/* Chrome trace event JSON of every traced run, loads in Perfetto as well */
+gboolean profile_write_trace(const gchar* path, GError** error);
+void profile_clear();
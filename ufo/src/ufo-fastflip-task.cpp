@@ -0,0 +1,227 @@
+#include "ufo-fastflip-task.h"
+
+#include <CL/cl.h>
+
+struct _UfoFastflipTaskPrivate
+{
+    UfoFastflipVariant variant;
+    guint local_size;
+    cl_kernel kernel;
+};
+
+static void ufo_task_interface_init(UfoTaskIface* iface);
+
+G_DEFINE_TYPE_WITH_CODE(UfoFastflipTask, ufo_fastflip_task, UFO_TYPE_TASK_NODE,
+    G_ADD_PRIVATE(UfoFastflipTask)
+    G_IMPLEMENT_INTERFACE(UFO_TYPE_TASK, ufo_task_interface_init))
+
+enum
+{
+    PROP_0,
+    PROP_VARIANT,
+    PROP_LOCAL_SIZE,
+    N_PROPERTIES
+};
+
+static GParamSpec* properties[N_PROPERTIES] = { NULL, };
+
+/* kernel name and pixels per work item of every variant */
+static const gchar* variant_kernels[] = { "fastflip_scalar", "fastflip_vec4", "fastflip_vec16" };
+static const guint variant_pixels[] = { 1, 4, 16 };
+
+static GType
+ufo_fastflip_variant_get_type()
+{
+    static GType type = 0;
+
+    if (type == 0)
+    {
+        static const GEnumValue values[] = {
+            { UFO_FASTFLIP_VARIANT_SCALAR, "UFO_FASTFLIP_VARIANT_SCALAR", "scalar" },
+            { UFO_FASTFLIP_VARIANT_VEC4, "UFO_FASTFLIP_VARIANT_VEC4", "vec4" },
+            { UFO_FASTFLIP_VARIANT_VEC16, "UFO_FASTFLIP_VARIANT_VEC16", "vec16" },
+            { 0, NULL, NULL }
+        };
+
+        type = g_enum_register_static("UfoFastflipVariant", values);
+    }
+
+    return type;
+}
+
+extern "C" UfoNode*
+ufo_fastflip_task_new()
+{
+    return UFO_NODE(g_object_new(UFO_TYPE_FASTFLIP_TASK, NULL));
+}
+
+static void
+ufo_fastflip_task_setup(UfoTask* task, UfoResources* resources, GError** error)
+{
+    UfoFastflipTaskPrivate* priv = UFO_FASTFLIP_TASK(task)->priv;
+
+    priv->kernel = (cl_kernel)ufo_resources_get_kernel(resources, "fastflip.cl",
+        variant_kernels[priv->variant], NULL, error);
+
+    if (priv->kernel != NULL)
+        UFO_RESOURCES_CHECK_SET_AND_RETURN(clRetainKernel(priv->kernel), error);
+}
+
+static void
+ufo_fastflip_task_get_requisition(UfoTask* task, UfoBuffer** inputs, UfoRequisition* requisition, GError** error)
+{
+    (void)task;
+    (void)error;
+
+    ufo_buffer_get_requisition(inputs[0], requisition);
+}
+
+static guint
+ufo_fastflip_task_get_num_inputs(UfoTask* task)
+{
+    (void)task;
+
+    return 1;
+}
+
+static guint
+ufo_fastflip_task_get_num_dimensions(UfoTask* task, guint input)
+{
+    (void)task;
+    (void)input;
+
+    return 2;
+}
+
+static UfoTaskMode
+ufo_fastflip_task_get_mode(UfoTask* task)
+{
+    (void)task;
+
+    return (UfoTaskMode)(UFO_TASK_MODE_PROCESSOR | UFO_TASK_MODE_GPU);
+}
+
+static gboolean
+ufo_fastflip_task_process(UfoTask* task, UfoBuffer** inputs, UfoBuffer* output, UfoRequisition* requisition)
+{
+    UfoFastflipTaskPrivate* priv = UFO_FASTFLIP_TASK(task)->priv;
+    UfoGpuNode* node = UFO_GPU_NODE(ufo_task_node_get_proc_node(UFO_TASK_NODE(task)));
+    cl_command_queue cmd_queue = (cl_command_queue)ufo_gpu_node_get_cmd_queue(node);
+    cl_mem in_mem = (cl_mem)ufo_buffer_get_device_array(inputs[0], cmd_queue);
+    cl_mem out_mem = (cl_mem)ufo_buffer_get_device_array(output, cmd_queue);
+    cl_uint width = requisition->dims[0];
+    /* a row flip does not care where frames end, so the slices of a stack
+     * are flipped as one tall frame in a single launch */
+    cl_uint height = requisition->dims[1] * (requisition->n_dims > 2 ? requisition->dims[2] : 1);
+    gsize local[2] = { priv->local_size, 1 };
+    gsize global[2];
+
+    /* one work item per vector of pixels, rounded up to whole work-groups */
+    global[0] = (width + variant_pixels[priv->variant] - 1) / variant_pixels[priv->variant];
+    if (priv->local_size > 0)
+        global[0] = (global[0] + priv->local_size - 1) / priv->local_size * priv->local_size;
+    global[1] = height;
+
+    UFO_RESOURCES_CHECK_CLERR(clSetKernelArg(priv->kernel, 0, sizeof(cl_mem), &in_mem));
+    UFO_RESOURCES_CHECK_CLERR(clSetKernelArg(priv->kernel, 1, sizeof(cl_mem), &out_mem));
+    UFO_RESOURCES_CHECK_CLERR(clSetKernelArg(priv->kernel, 2, sizeof(cl_uint), &width));
+    UFO_RESOURCES_CHECK_CLERR(clSetKernelArg(priv->kernel, 3, sizeof(cl_uint), &height));
+
+    UfoProfiler* profiler = ufo_task_node_get_profiler(UFO_TASK_NODE(task));
+    ufo_profiler_call(profiler, cmd_queue, priv->kernel, 2, global, priv->local_size > 0 ? local : NULL);
+
+    return TRUE;
+}
+
+static void
+ufo_fastflip_task_set_property(GObject* object, guint property_id, const GValue* value, GParamSpec* pspec)
+{
+    UfoFastflipTaskPrivate* priv = UFO_FASTFLIP_TASK(object)->priv;
+
+    switch (property_id)
+    {
+    case PROP_VARIANT:
+        priv->variant = (UfoFastflipVariant)g_value_get_enum(value);
+        break;
+    case PROP_LOCAL_SIZE:
+        priv->local_size = g_value_get_uint(value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+static void
+ufo_fastflip_task_get_property(GObject* object, guint property_id, GValue* value, GParamSpec* pspec)
+{
+    UfoFastflipTaskPrivate* priv = UFO_FASTFLIP_TASK(object)->priv;
+
+    switch (property_id)
+    {
+    case PROP_VARIANT:
+        g_value_set_enum(value, priv->variant);
+        break;
+    case PROP_LOCAL_SIZE:
+        g_value_set_uint(value, priv->local_size);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        break;
+    }
+}
+
+static void
+ufo_fastflip_task_finalize(GObject* object)
+{
+    UfoFastflipTaskPrivate* priv = UFO_FASTFLIP_TASK(object)->priv;
+
+    if (priv->kernel != NULL)
+    {
+        UFO_RESOURCES_CHECK_CLERR(clReleaseKernel(priv->kernel));
+        priv->kernel = NULL;
+    }
+
+    G_OBJECT_CLASS(ufo_fastflip_task_parent_class)->finalize(object);
+}
+
+static void
+ufo_task_interface_init(UfoTaskIface* iface)
+{
+    iface->setup = ufo_fastflip_task_setup;
+    iface->get_num_inputs = ufo_fastflip_task_get_num_inputs;
+    iface->get_num_dimensions = ufo_fastflip_task_get_num_dimensions;
+    iface->get_mode = ufo_fastflip_task_get_mode;
+    iface->get_requisition = ufo_fastflip_task_get_requisition;
+    iface->process = ufo_fastflip_task_process;
+}
+
+static void
+ufo_fastflip_task_class_init(UfoFastflipTaskClass* klass)
+{
+    GObjectClass* oclass = G_OBJECT_CLASS(klass);
+
+    oclass->set_property = ufo_fastflip_task_set_property;
+    oclass->get_property = ufo_fastflip_task_get_property;
+    oclass->finalize = ufo_fastflip_task_finalize;
+
+    properties[PROP_VARIANT] =
+        g_param_spec_enum("variant", "Kernel variant", "Pixels per work item, scalar, vec4 or vec16",
+            ufo_fastflip_variant_get_type(), UFO_FASTFLIP_VARIANT_VEC4, G_PARAM_READWRITE);
+
+    properties[PROP_LOCAL_SIZE] =
+        g_param_spec_uint("local-size", "Work-group size", "Work items per work-group along a row, 0 lets the driver choose",
+            0, 1024, 0, G_PARAM_READWRITE);
+
+    for (guint i = PROP_0 + 1; i < N_PROPERTIES; i++)
+        g_object_class_install_property(oclass, i, properties[i]);
+}
+
+static void
+ufo_fastflip_task_init(UfoFastflipTask* self)
+{
+    self->priv = (UfoFastflipTaskPrivate*)ufo_fastflip_task_get_instance_private(self);
+    self->priv->variant = UFO_FASTFLIP_VARIANT_VEC4;
+    self->priv->local_size = 0;
+    self->priv->kernel = NULL;
+}
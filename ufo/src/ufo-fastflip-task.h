@@ -0,0 +1,39 @@
+#pragma once
+
+#include <ufo/ufo.h>
+
+G_BEGIN_DECLS
+
+#define UFO_TYPE_FASTFLIP_TASK (ufo_fastflip_task_get_type())
+#define UFO_FASTFLIP_TASK(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), UFO_TYPE_FASTFLIP_TASK, UfoFastflipTask))
+
+typedef struct _UfoFastflipTask UfoFastflipTask;
+typedef struct _UfoFastflipTaskClass UfoFastflipTaskClass;
+typedef struct _UfoFastflipTaskPrivate UfoFastflipTaskPrivate;
+
+typedef enum
+{
+    UFO_FASTFLIP_VARIANT_SCALAR,
+    UFO_FASTFLIP_VARIANT_VEC4,
+    UFO_FASTFLIP_VARIANT_VEC16,
+} UfoFastflipVariant;
+
+/* Horizontal flip with vectorized loads and a tunable work-group size, a
+ * replacement for the stock flip task */
+struct _UfoFastflipTask
+{
+    UfoTaskNode parent_instance;
+
+    UfoFastflipTaskPrivate* priv;
+};
+
+struct _UfoFastflipTaskClass
+{
+    UfoTaskNodeClass parent_class;
+};
+
+/* Looked up by UfoPluginManager when the "fastflip" task is requested */
+UfoNode* ufo_fastflip_task_new();
+GType ufo_fastflip_task_get_type();
+
+G_END_DECLS